@@ -0,0 +1,302 @@
+#include <stdio.h>  /* printf, fprintf, vsnprintf, snprintf, fopen, fread, fwrite, fclose */
+#include <stdarg.h> /* va_list, va_start, va_end */
+#include <stdlib.h> /* malloc, realloc, free, EXIT_FAILURE */
+#include <string.h> /* memcpy, strlen, strrchr */
+#include <time.h>   /* clock, CLOCKS_PER_SEC */
+
+/* Every allocation of the library goes through these, so they can be counted */
+static size_t benchAllocs = 0, benchFrees = 0;
+
+static void *benchAlloc(size_t size) {
+	++ benchAllocs;
+	return malloc(size);
+}
+
+static void *benchRealloc(void *ptr, size_t size) {
+	if (ptr == NULL)
+		++ benchAllocs;
+
+	return realloc(ptr, size);
+}
+
+static void benchFree(void *ptr) {
+	if (ptr != NULL)
+		++ benchFrees;
+
+	free(ptr);
+}
+
+#define nochAlloc(SIZE)        benchAlloc(SIZE)
+#define nochRealloc(PTR, SIZE) benchRealloc(PTR, SIZE)
+#define nochFree(PTR)          benchFree(PTR)
+
+#include <noch/json.h>
+#include <noch/json.c>
+
+/* Each measurement is the best of this many runs */
+#define RUNS 5
+
+/* The corpus is generated from a fixed seed, so every run benchmarks the same input */
+static unsigned long seed;
+
+static unsigned long randomNext(void) {
+	seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+	return (seed >> 33) & 0x7FFFFFFF;
+}
+
+typedef struct {
+	char  *data;
+	size_t size, cap;
+} Buffer;
+
+static void bufferAppend(Buffer *this, const char *str, size_t size) {
+	if (this->size + size + 1 > this->cap) {
+		while (this->size + size + 1 > this->cap)
+			this->cap = this->cap == 0? 4096 : this->cap * 2;
+
+		this->data = (char*)realloc(this->data, this->cap);
+		if (this->data == NULL)
+			NOCH_OUT_OF_MEM();
+	}
+
+	memcpy(this->data + this->size, str, size);
+	this->size += size;
+	this->data[this->size] = '\0';
+}
+
+static void bufferPrint(Buffer *this, const char *fmt, ...) {
+	char    str[256];
+	va_list args;
+	va_start(args, fmt);
+	int length = vsnprintf(str, sizeof(str), fmt, args);
+	va_end(args);
+
+	bufferAppend(this, str, (size_t)length < sizeof(str)? (size_t)length : sizeof(str) - 1);
+}
+
+/* A list of small records, the most common shape of real documents */
+static void generateRecords(Buffer *this) {
+	bufferAppend(this, "[\n", 2);
+	for (size_t i = 0; i < 40000; ++ i) {
+		bufferPrint(this, "\t{\"id\": %lu, \"name\": \"user%lu\", \"score\": %lu.%02lu, "
+		            "\"active\": %s, \"tags\": [\"t%lu\", \"t%lu\"], \"parent\": null}%s\n",
+		            (long unsigned)i, randomNext() % 100000, randomNext() % 1000, randomNext() % 100,
+		            randomNext() % 2? "true" : "false", randomNext() % 16, randomNext() % 16,
+		            i + 1 < 40000? "," : "");
+	}
+	bufferAppend(this, "]\n", 2);
+}
+
+/* A single object with many keys, which stresses the key index */
+static void generateWide(Buffer *this) {
+	bufferAppend(this, "{\n", 2);
+	for (size_t i = 0; i < 100000; ++ i)
+		bufferPrint(this, "\t\"key_%lu_%lu\": %lu%s\n", (long unsigned)i, randomNext() % 1000,
+		            randomNext(), i + 1 < 100000? "," : "");
+	bufferAppend(this, "}\n", 2);
+}
+
+/* Containers nested hundreds of levels deep */
+static void generateDeep(Buffer *this) {
+	bufferAppend(this, "[", 1);
+	for (size_t i = 0; i < 2000; ++ i) {
+		size_t depth = 100 + randomNext() % 400;
+		for (size_t j = 0; j < depth; ++ j)
+			bufferAppend(this, j % 2? "{\"a\":" : "[", j % 2? 5 : 1);
+
+		bufferPrint(this, "%lu", randomNext() % 100);
+		for (size_t j = depth; j -- > 0;)
+			bufferAppend(this, j % 2? "}" : "]", 1);
+
+		if (i + 1 < 2000)
+			bufferAppend(this, ",", 1);
+	}
+	bufferAppend(this, "]\n", 2);
+}
+
+/* Long strings, some of them with escapes and UTF-8 */
+static void generateStrings(Buffer *this) {
+	static const char *pieces[] = {
+		"lorem ipsum dolor sit amet ", "consectetur adipiscing elit ", "\\\"quoted\\\" ",
+		"tab\\there ", "line\\nbreak ", "\\u00e9t\\u00e9 ", "\xc5\xbelu\xc5\xa5ou\xc4\x8dk\xc3\xbd ",
+		"\\ud83d\\ude00 ",
+	};
+
+	bufferAppend(this, "[\n", 2);
+	for (size_t i = 0; i < 20000; ++ i) {
+		bufferAppend(this, "\t\"", 2);
+
+		size_t count = 4 + randomNext() % 12;
+		for (size_t j = 0; j < count; ++ j) {
+			/* Most strings are plain */
+			size_t piece = i % 4 == 0? randomNext() % 8 : randomNext() % 2;
+			bufferAppend(this, pieces[piece], strlen(pieces[piece]));
+		}
+
+		bufferAppend(this, i + 1 < 20000? "\",\n" : "\"\n", i + 1 < 20000? 3 : 2);
+	}
+	bufferAppend(this, "]\n", 2);
+}
+
+/* Integers of all sizes and floats with fractions and exponents */
+static void generateNumbers(Buffer *this) {
+	bufferAppend(this, "[\n", 2);
+	for (size_t i = 0; i < 200000; ++ i) {
+		switch (i % 4) {
+		case 0: bufferPrint(this, "\t%lu", randomNext() % 1000); break;
+		case 1: bufferPrint(this, "\t-%lu%09lu", randomNext(), randomNext() % 1000000000); break;
+		case 2: bufferPrint(this, "\t%lu.%06lu", randomNext() % 100000, randomNext() % 1000000); break;
+		case 3: bufferPrint(this, "\t%lu.%03lue-%lu", randomNext() % 10, randomNext() % 1000,
+		                    randomNext() % 300); break;
+		}
+
+		bufferAppend(this, i + 1 < 200000? ",\n" : "\n", i + 1 < 200000? 2 : 1);
+	}
+	bufferAppend(this, "]\n", 2);
+}
+
+typedef struct {
+	const char *name;
+	void      (*generate)(Buffer*);
+} Corpus;
+
+static const Corpus corpora[] = {
+	{"records", generateRecords},
+	{"wide",    generateWide},
+	{"deep",    generateDeep},
+	{"strings", generateStrings},
+	{"numbers", generateNumbers},
+};
+
+static double seconds(clock_t start) {
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void report(const char *name, const char *op, size_t size, double best,
+                   size_t count, const char *counted) {
+	printf("%-10s %-14s %10.1f MB/s %10lu %s\n", name, op,
+	       best > 0? (double)size / 1e6 / best : 0.0, (long unsigned)count, counted);
+}
+
+static int bench(const char *name, const char *text, size_t size, const char *path) {
+	double best[4] = {-1, -1, -1, -1};
+	size_t allocs[4], outputSize = 0;
+
+	for (int run = 0; run < RUNS; ++ run) {
+		size_t  prevAllocs = benchAllocs;
+		clock_t start      = clock();
+		Json   *json       = jsonFromString(text);
+		double  time       = seconds(start);
+		if (json == NULL)
+			return -1;
+
+		if (best[0] < 0 || time < best[0])
+			best[0] = time;
+		allocs[0] = benchAllocs - prevAllocs;
+
+		prevAllocs = benchAllocs;
+		start      = clock();
+		char *out  = jsonStringify(json);
+		time       = seconds(start);
+		if (best[1] < 0 || time < best[1])
+			best[1] = time;
+		allocs[1]  = benchAllocs - prevAllocs;
+		outputSize = strlen(out);
+		free(out);
+
+		size_t prevFrees = benchFrees;
+		start = clock();
+		jsonDestroy(json);
+		time  = seconds(start);
+		if (best[2] < 0 || time < best[2])
+			best[2] = time;
+		allocs[2] = benchFrees - prevFrees;
+
+		if (path == NULL)
+			continue;
+
+		prevAllocs = benchAllocs;
+		start      = clock();
+		json       = jsonFromFile(path);
+		time       = seconds(start);
+		if (json == NULL)
+			return -1;
+
+		if (best[3] < 0 || time < best[3])
+			best[3] = time;
+		allocs[3] = benchAllocs - prevAllocs;
+		jsonDestroy(json);
+	}
+
+	report(name, "jsonFromString", size,       best[0], allocs[0], "allocs");
+	if (path != NULL)
+		report(name, "jsonFromFile", size,     best[3], allocs[3], "allocs");
+	report(name, "jsonStringify",  outputSize, best[1], allocs[1], "allocs");
+	report(name, "jsonDestroy",    size,       best[2], allocs[2], "frees");
+	return 0;
+}
+
+static int benchFile(const char *path) {
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "Error: Could not open \"%s\"\n", path);
+		return -1;
+	}
+
+	Buffer buf = {0};
+	char   chunk[65536];
+	size_t read;
+	while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+		bufferAppend(&buf, chunk, read);
+
+	fclose(file);
+
+	const char *name = strrchr(path, '/');
+	int ret = bench(name == NULL? path : name + 1, buf.data == NULL? "" : buf.data, buf.size, path);
+	free(buf.data);
+	return ret;
+}
+
+/* Without arguments the generated corpus is benchmarked (and written to bin/ for jsonFromFile),
+   otherwise the given files are */
+int main(int argc, const char **argv) {
+	printf("%-10s %-14s %15s\n", "corpus", "operation", "throughput");
+
+	if (argc > 1) {
+		for (int i = 1; i < argc; ++ i) {
+			if (benchFile(argv[i]) != 0) {
+				fprintf(stderr, "Error: %s\n", nochGetError());
+				return EXIT_FAILURE;
+			}
+		}
+
+		return 0;
+	}
+
+	for (size_t i = 0; i < sizeof(corpora) / sizeof(*corpora); ++ i) {
+		Buffer buf = {0};
+		seed = 42;
+		corpora[i].generate(&buf);
+
+		char  path[256];
+		snprintf(path, sizeof(path), "bin/bench_%s.json", corpora[i].name);
+
+		FILE *file = fopen(path, "wb");
+		if (file != NULL) {
+			if (fwrite(buf.data, 1, buf.size, file) != buf.size) {
+				fclose(file);
+				file = NULL;
+			} else
+				fclose(file);
+		}
+
+		int ret = bench(corpora[i].name, buf.data, buf.size, file == NULL? NULL : path);
+		free(buf.data);
+		if (ret != 0) {
+			fprintf(stderr, "Error: %s\n", nochGetError());
+			return EXIT_FAILURE;
+		}
+	}
+
+	return 0;
+}
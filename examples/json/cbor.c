@@ -0,0 +1,34 @@
+#include <stdio.h>  /* fprintf, printf */
+#include <stdlib.h> /* EXIT_FAILURE, free */
+
+#include <noch/json.h>
+#include <noch/json.c>
+
+int main(void) {
+	Json *json = jsonFromString("{\"name\": \"noch\", \"version\": [1, 2], \"stable\": false}");
+	if (json == NULL) {
+		fprintf(stderr, "Error: %s\n", nochGetError());
+		return EXIT_FAILURE;
+	}
+
+	size_t size;
+	char  *cbor = jsonToCbor(json, &size);
+	jsonDestroy(json);
+
+	printf("%lu bytes:", (long unsigned)size);
+	for (size_t i = 0; i < size; ++ i)
+		printf(" %02x", (unsigned char)cbor[i]);
+	printf("\n");
+
+	/* The document points into the CBOR buffer, which is freed after it */
+	JsonDoc *doc = jsonDocFromCborInSitu(cbor, size);
+	if (doc == NULL) {
+		fprintf(stderr, "Error: %s\n", nochGetError());
+		return EXIT_FAILURE;
+	}
+
+	jsonPrintF(doc->root, stdout);
+	jsonDocDestroy(doc);
+	free(cbor);
+	return 0;
+}
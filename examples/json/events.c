@@ -0,0 +1,57 @@
+#include <stdio.h>  /* fprintf, printf */
+#include <stdlib.h> /* EXIT_FAILURE */
+
+#include <noch/json.h>
+#include <noch/json.c>
+
+typedef struct {
+	size_t depth, keys, values;
+} Stats;
+
+static int onBegin(void *data) {
+	++ ((Stats*)data)->depth;
+	return 0;
+}
+
+static int onEnd(void *data) {
+	-- ((Stats*)data)->depth;
+	return 0;
+}
+
+static int onKey(void *data, const char *key, size_t length) {
+	Stats *stats = (Stats*)data;
+	printf("%*s%.*s\n", (int)stats->depth * 2, "", (int)length, key);
+
+	++ stats->keys;
+	return 0;
+}
+
+static int onString(void *data, const char *value, size_t length) {
+	(void)value;
+	(void)length;
+
+	++ ((Stats*)data)->values;
+	return 0;
+}
+
+int main(void) {
+	const char *path = "examples/json/data.json";
+	printf("Reading '%s'\n", path);
+
+	JsonHandler handler = {0};
+	handler.objBegin  = onBegin;
+	handler.objEnd    = onEnd;
+	handler.listBegin = onBegin;
+	handler.listEnd   = onEnd;
+	handler.key       = onKey;
+	handler.string    = onString;
+
+	Stats stats = {0};
+	if (jsonEventsFromFile(path, &handler, &stats) != 0) {
+		fprintf(stderr, "Error: %s\n", nochGetError());
+		return EXIT_FAILURE;
+	}
+
+	printf("%lu keys, %lu string values\n", (long unsigned)stats.keys, (long unsigned)stats.values);
+	return 0;
+}
@@ -0,0 +1,43 @@
+#include <stdio.h>  /* fprintf, printf */
+#include <stdlib.h> /* EXIT_FAILURE, free */
+
+#include <noch/json.h>
+#include <noch/json.c>
+
+static const char *request =
+	"{\n"
+	"	\"headers\": {\"accept\": \"*/*\", \"user-agent\": \"noch\"},\n"
+	"	\"body\":    [[1, 2, 3], {\"nested\": [\"skipped\", \"without\", \"parsing\"]}],\n"
+	"	\"method\":  \"GET\",\n"
+	"	\"retries\": 3\n"
+	"}\n";
+
+int main(void) {
+	JsonLazy root, method, retries, agent;
+	if (jsonLazyFromString(request, &root) != 0 ||
+	    jsonLazyObjAt(&root, "method",  &method)  != 0 ||
+	    jsonLazyObjAt(&root, "retries", &retries) != 0 ||
+	    jsonLazyObjAt(&root, "headers", &agent)   != 0 ||
+	    jsonLazyObjAt(&agent, "user-agent", &agent) != 0) {
+		fprintf(stderr, "Error: %s\n", nochGetError());
+		return EXIT_FAILURE;
+	}
+
+	int64_t count;
+	char   *methodValue = jsonLazyString(&method, NULL);
+	char   *agentValue  = jsonLazyString(&agent,  NULL);
+	if (methodValue == NULL || agentValue == NULL || jsonLazyInt(&retries, &count) != 0) {
+		fprintf(stderr, "Error: %s\n", nochGetError());
+		return EXIT_FAILURE;
+	}
+
+	printf("%s request from %s, %lli retries\n", methodValue, agentValue, (long long)count);
+	free(methodValue);
+	free(agentValue);
+
+	JsonLazy missing;
+	if (jsonLazyObjAt(&root, "missing", &missing) != 0)
+		printf("Error: %s\n", nochGetError());
+
+	return 0;
+}
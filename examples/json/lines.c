@@ -0,0 +1,31 @@
+#include <stdio.h>  /* fprintf, printf */
+#include <stdlib.h> /* EXIT_FAILURE */
+
+#include <noch/json.h>
+#include <noch/json.c>
+
+static int onRecord(void *data, size_t line, Json *json) {
+	int64_t *total = (int64_t*)data;
+
+	JsonObj *record = JSON_OBJ(json);
+	JsonInt *price  = JSON_INT(*jsonObjAt(record, "price"));
+	printf("%lu: %s\n", (long unsigned)line, JSON_STRING(*jsonObjAt(record, "name"))->data);
+
+	*total += price->value;
+	jsonDestroy(json);
+	return 0;
+}
+
+int main(void) {
+	const char *path = "examples/json/data.jsonl";
+	printf("Reading '%s'\n", path);
+
+	int64_t total = 0;
+	if (jsonLinesFromFile(path, 0, true, onRecord, &total) != 0) {
+		fprintf(stderr, "Error: %s\n", nochGetError());
+		return EXIT_FAILURE;
+	}
+
+	printf("Total: %lli\n", (long long)total);
+	return 0;
+}
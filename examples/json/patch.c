@@ -0,0 +1,69 @@
+#include <stdio.h>  /* fprintf, printf */
+#include <stdlib.h> /* EXIT_FAILURE, free */
+
+#include <noch/json.h>
+#include <noch/json.c>
+
+static const char *state =
+	"{\n"
+	"\t/* Written by the server */\n"
+	"\t\"version\": 3,\n"
+	"\t\"users\": [\"alice\", \"bob\"],\n"
+	"\t\"limits\": {\"cpu\": 2, \"memory\": 512}\n"
+	"}\n";
+
+static const char *patch =
+	"["
+	"{\"op\": \"test\",    \"path\": \"/version\",      \"value\": 3.0},"
+	"{\"op\": \"replace\", \"path\": \"/version\",      \"value\": 4},"
+	"{\"op\": \"add\",     \"path\": \"/users/-\",      \"value\": \"carol\"},"
+	"{\"op\": \"remove\",  \"path\": \"/users/0\"},"
+	"{\"op\": \"copy\",    \"from\": \"/limits/cpu\",   \"path\": \"/limits/gpu\"}"
+	"]";
+
+static const char *mergePatch = "{\"limits\": {\"memory\": null, \"disk\": 100}, \"owner\": \"bob\"}";
+
+static int error(void) {
+	fprintf(stderr, "Error: %s\n", nochGetError());
+	return EXIT_FAILURE;
+}
+
+int main(void) {
+	Json *ops = jsonFromString(patch), *merge = jsonFromString(mergePatch);
+	if (ops == NULL || merge == NULL)
+		return error();
+
+	/* Patching the tree */
+	Json *json = jsonFromString(state);
+	if (json == NULL)
+		return error();
+
+	if (jsonPatch(&json, ops) != 0)
+		return error();
+
+	jsonMergePatch(&json, merge);
+
+	/* A move to a missing parent fails without losing the moved value */
+	Json *move = jsonFromString("[{\"op\": \"move\", \"from\": \"/owner\", \"path\": \"/missing/x\"}]");
+	if (move == NULL)
+		return error();
+
+	if (jsonPatch(&json, move) == 0)
+		return EXIT_FAILURE;
+
+	jsonDestroy(move);
+	jsonPrintF(json, stdout);
+	jsonDestroy(json);
+
+	/* Patching the text only rewrites the changed values, the comment and the layout are kept */
+	char *text = jsonPatchText(state, ops, NULL);
+	if (text == NULL)
+		return error();
+
+	printf("%s", text);
+	free(text);
+
+	jsonDestroy(ops);
+	jsonDestroy(merge);
+	return 0;
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>  /* fprintf, printf */
+#include <stdlib.h> /* EXIT_FAILURE */
+
+#include <noch/json.h>
+#include <noch/json.c>
+
+static const char *requests[] = {
+	"{\"user\": {\"name\": \"alice\", \"roles\": [\"admin\", \"dev\"]}}",
+	"{\"user\": {\"name\": \"bob\",   \"roles\": [\"guest\"]}}",
+	"{\"user\": {\"id\": 5}}",
+};
+
+int main(void) {
+	/* Compiled once, evaluated against every request */
+	JsonPath *name = jsonPathCompile("user.name");
+	JsonPath *role = jsonPathCompile("/user/roles/0");
+	if (name == NULL || role == NULL) {
+		fprintf(stderr, "Error: %s\n", nochGetError());
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < sizeof(requests) / sizeof(*requests); ++ i) {
+		Json *json = jsonFromString(requests[i]);
+		if (json == NULL) {
+			fprintf(stderr, "Error: %s\n", nochGetError());
+			return EXIT_FAILURE;
+		}
+
+		Json *nameValue = jsonPathGet(name, json);
+		Json *roleValue = jsonPathGet(role, json);
+		printf("%s: %s\n", nameValue == NULL? "(unknown)" : JSON_STRING(nameValue)->data,
+		       roleValue == NULL? "(none)" : JSON_STRING(roleValue)->data);
+
+		Json *last = jsonQuery(json, "$.user[\"roles\"][-1]");
+		if (last != NULL)
+			printf("  last role: %s\n", JSON_STRING(last)->data);
+
+		jsonDestroy(json);
+	}
+
+	jsonPathDestroy(name);
+	jsonPathDestroy(role);
+
+	/* "~0" unescapes to "~", so this names the key "1~" and not an index of the list */
+	Json *list = jsonFromString("[10, 11, 12]");
+	if (list == NULL) {
+		fprintf(stderr, "Error: %s\n", nochGetError());
+		return EXIT_FAILURE;
+	}
+
+	printf("/1: %s, /1~0: %s\n", jsonQuery(list, "/1")   == NULL? "(none)" : "found",
+	       jsonQuery(list, "/1~0") == NULL? "(none)" : "found");
+
+	/* A selector can start with a bracket, the "$" is optional */
+	Json *first = jsonQuery(list, "[0]");
+	if (first != NULL)
+		printf("[0]: %lld\n", (long long)JSON_INT(first)->value);
+	jsonDestroy(list);
+	return 0;
+}
@@ -0,0 +1,71 @@
+#include <stdio.h>  /* fprintf, printf */
+#include <stdlib.h> /* EXIT_FAILURE, free */
+
+#include <noch/json.h>
+#include <noch/json.c>
+
+typedef struct {
+	char   *name;
+	int64_t port;
+} Server;
+
+typedef struct {
+	char   *title;
+	double  timeout;
+	bool    verbose;
+	Server  primary;
+	Server *backups;
+	size_t  backupsCount;
+} Config;
+
+static const JsonField serverFields[] = {
+	JSON_MEMBER(Server, name, STRING),
+	JSON_MEMBER(Server, port, INT),
+	JSON_FIELDS_END,
+};
+
+static const JsonField serverItem = JSON_ITEM_STRUCT(Server, serverFields);
+
+static const JsonField configFields[] = {
+	JSON_MEMBER(Config, title,   STRING),
+	JSON_MEMBER(Config, timeout, FLOAT),
+	JSON_MEMBER(Config, verbose, BOOL),
+	JSON_MEMBER_STRUCT(Config, primary, serverFields),
+	JSON_MEMBER_LIST(Config, backups, backupsCount, &serverItem),
+	JSON_FIELDS_END,
+};
+
+int main(void) {
+	const char *in = "{\n"
+	                 "\t\"title\": \"Example\",\n"
+	                 "\t\"timeout\": 2.5,\n"
+	                 "\t\"unused\": {\"skipped\": [1, 2, 3]},\n"
+	                 "\t\"primary\": {\"name\": \"main\", \"port\": 8080},\n"
+	                 "\t\"backups\": [\n"
+	                 "\t\t{\"name\": \"first\", \"port\": 8081},\n"
+	                 "\t\t{\"name\": \"second\", \"port\": 8082}\n"
+	                 "\t]\n"
+	                 "}";
+
+	/* Missing keys keep their defaults */
+	Config config = {0};
+	config.verbose = true;
+
+	if (jsonStructFromString(in, configFields, &config) != 0) {
+		fprintf(stderr, "Error: %s\n", nochGetError());
+		jsonStructFree(configFields, &config);
+		return EXIT_FAILURE;
+	}
+
+	printf("%s: timeout %f, primary %s:%li\n", config.title, config.timeout,
+	       config.primary.name, (long)config.primary.port);
+	for (size_t i = 0; i < config.backupsCount; ++ i)
+		printf("Backup %s:%li\n", config.backups[i].name, (long)config.backups[i].port);
+
+	char *out = jsonStructStringify(configFields, &config, JSON_INDENT_TAB);
+	printf("%s", out);
+	free(out);
+
+	jsonStructFree(configFields, &config);
+	return 0;
+}
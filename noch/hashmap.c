@@ -1,7 +1,7 @@
 #include "internal/alloc.h"
 #include "internal/assert.h"
 
-#include "args.h"
+#include "hashmap.h"
 
 NOCH_DEF unsigned hashFuncOneAtATime(const char *str) {
 	unsigned hash = 0;
@@ -25,29 +25,57 @@ NOCH_DEF unsigned hashFuncDefault(const char *str) {
 	return hash;
 }
 
+typedef union {
+	void       *ptr;
+	long long   integer;
+	long double real;
+} HashmapAlign;
+
+#define HASHMAP_ALIGN_OF(T) offsetof(struct { char ch; T value; }, value)
+
 #define HASHMAP_BUCKET_VAL(BUCKET) (void*)((char*)(BUCKET) + sizeof(HashmapBucket))
 #define HASHMAP_BUCKET_AT(HASHMAP, IDX) \
-	(HashmapBucket*)((char*)this->buckets + ((HASHMAP)->bucketSize * (IDX)))
+	((HashmapBucket*)((char*)(HASHMAP)->buckets + (HASHMAP)->bucketSize * (IDX)))
+
+static void hashmapAllocBuckets(Hashmap *this, size_t cap) {
+	this->cap     = cap;
+	this->buckets = nochAlloc(this->cap * this->bucketSize);
+	if (this->buckets == NULL)
+		NOCH_OUT_OF_MEM();
+
+	memset(this->buckets, 0, this->cap * this->bucketSize);
+}
 
 NOCH_DEF int hashmapInit_(Hashmap *this, size_t cap, size_t valueSize,
                           HashmapHashFunc hash, HashmapDestructor destruct) {
-	this->cap        = cap;
+	/* Buckets are padded, so the keys and values of all of them stay aligned. The alignment of a
+	   type divides its size, so the largest power of two dividing the value size is enough */
+	size_t align = valueSize & (~valueSize + 1);
+	if (align == 0 || align > HASHMAP_ALIGN_OF(HashmapAlign))
+		align = HASHMAP_ALIGN_OF(HashmapAlign);
+	if (align < HASHMAP_ALIGN_OF(HashmapBucket))
+		align = HASHMAP_ALIGN_OF(HashmapBucket);
+
+	this->size       = 0;
 	this->valueSize  = valueSize;
-	this->bucketSize = sizeof(HashmapBucket) + valueSize;
+	this->bucketSize = (sizeof(HashmapBucket) + valueSize + align - 1) / align * align;
+	this->maxLoad    = HASHMAP_DEFAULT_MAX_LOAD;
 	this->hash       = hash;
 	this->destruct   = destruct;
-	this->buckets    = nochAlloc(this->cap * this->bucketSize);
-	if (this->buckets == NULL)
-		NOCH_OUT_OF_MEM();
 
-	memset(this->buckets, 0, this->cap * this->bucketSize);
+	/* Indices are masked out of the hashes */
+	size_t pow2 = 8;
+	while (pow2 < cap)
+		pow2 *= 2;
+
+	hashmapAllocBuckets(this, pow2);
 	return 0;
 }
 
 NOCH_DEF void hashmapDeinit_(Hashmap *this) {
 	if (this->destruct != NULL) {
-		for (size_t i = 0; i < this->cap * this->valueSize; i += this->valueSize) {
-			HashmapBucket *bucket = (HashmapBucket*)((char*)this->buckets + i);
+		for (size_t i = 0; i < this->cap; ++ i) {
+			HashmapBucket *bucket = HASHMAP_BUCKET_AT(this, i);
 			if (bucket->full)
 				this->destruct(HASHMAP_BUCKET_VAL(bucket));
 		}
@@ -57,51 +85,64 @@ NOCH_DEF void hashmapDeinit_(Hashmap *this) {
 }
 
 static bool hashmapBucketMatches(HashmapBucket *bucket, unsigned hash, const char *key) {
-	if (!bucket->full || bucket->hash != hash)
+	if (bucket->hash != hash)
 		return false;
 	else
 		return strcmp(bucket->key, key) == 0;
 }
 
-static HashmapBucket *hashmapFind(Hashmap *this, const char *key) {
-	unsigned hash = this->hash(key);
-	size_t   idx  = hash % this->cap;
-
-	HashmapBucket *bucket = HASHMAP_BUCKET_AT(this, idx);
+/* Probes from the home bucket of the hash, returns the bucket with the key or the empty one where
+   it would go. The load factor keeps empty buckets around, so a miss ends at the first one */
+static HashmapBucket *hashmapProbe(Hashmap *this, unsigned hash, const char *key) {
+	size_t mask = this->cap - 1;
+	for (size_t i = hash & mask;; i = (i + 1) & mask) {
+		HashmapBucket *bucket = HASHMAP_BUCKET_AT(this, i);
+		if (!bucket->full || (key != NULL && hashmapBucketMatches(bucket, hash, key)))
+			return bucket;
+	}
+}
 
-	if (!bucket->full)
-		return NULL;
-	else if (!hashmapBucketMatches(bucket, hash, key)) {
-		bool found = false;
-		for (size_t i = idx + 1; i != idx; ++ i) {
-			if (i >= this->cap)
-				i = 0;
-
-			bucket = HASHMAP_BUCKET_AT(this, i);
-			if (hashmapBucketMatches(bucket, hash, key)) {
-				found = true;
-				break;
-			}
-		}
+static HashmapBucket *hashmapFind(Hashmap *this, const char *key) {
+	HashmapBucket *bucket = hashmapProbe(this, this->hash(key), key);
+	return bucket->full? bucket : NULL;
+}
 
-		if (!found)
-			return NULL;
-	}
+/* Moves a full bucket to the first empty one of its probe sequence, without hashing the key again */
+static void hashmapPlace(Hashmap *this, HashmapBucket *bucket) {
+	HashmapBucket *slot = hashmapProbe(this, bucket->hash, NULL);
+	if (slot != bucket)
+		memcpy(slot, bucket, this->bucketSize);
 
-	return bucket;
+	slot->full = true;
 }
 
+/* Backward shift deletion: the buckets after the removed one in its cluster are moved back into
+   the hole, unless their home bucket is past it. Probe sequences stay unbroken without tombstones */
 NOCH_DEF int hashmapRemove_(Hashmap *this, const char *key) {
 	HashmapBucket *bucket = hashmapFind(this, key);
 	if (bucket == NULL)
 		return -1;
 
-	bucket->hash = 0;
-	bucket->full = false;
-
 	if (this->destruct != NULL)
 		this->destruct(HASHMAP_BUCKET_VAL(bucket));
 
+	size_t mask = this->cap - 1;
+	size_t hole = ((char*)bucket - (char*)this->buckets) / this->bucketSize;
+	for (size_t i = (hole + 1) & mask;; i = (i + 1) & mask) {
+		HashmapBucket *next = HASHMAP_BUCKET_AT(this, i);
+		if (!next->full)
+			break;
+
+		/* It can move if the hole is no further from its home than it is */
+		size_t home = next->hash & mask;
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			memcpy(HASHMAP_BUCKET_AT(this, hole), next, this->bucketSize);
+			hole = i;
+		}
+	}
+
+	HASHMAP_BUCKET_AT(this, hole)->full = false;
+	-- this->size;
 	return 0;
 }
 
@@ -113,58 +154,39 @@ NOCH_DEF void *hashmapGet_(Hashmap *this, const char *key) {
 	return HASHMAP_BUCKET_VAL(bucket);
 }
 
-static int hashmapResize(Hashmap *this, size_t newCap) {
-	size_t         prev_cap     = this->cap;
-	HashmapBucket *prev_buckets = this->buckets;
-
-	this->cap     = newCap;
-	this->buckets = nochAlloc(this->cap * this->bucketSize);
-	if (this->buckets == NULL)
-		NOCH_OUT_OF_MEM();
+static void hashmapResize(Hashmap *this, size_t newCap) {
+	size_t prevCap     = this->cap;
+	void  *prevBuckets = this->buckets;
 
-	memset(this->buckets, 0, this->cap * this->bucketSize);
-
-	for (size_t i = 0; i < prev_cap * this->valueSize; i += this->valueSize) {
-		HashmapBucket *bucket = (HashmapBucket*)((char*)prev_buckets + i);
-		hashmapSet_(this, bucket->key, HASHMAP_BUCKET_VAL(bucket));
+	hashmapAllocBuckets(this, newCap);
+	for (size_t i = 0; i < prevCap; ++ i) {
+		HashmapBucket *bucket = (HashmapBucket*)((char*)prevBuckets + this->bucketSize * i);
+		if (bucket->full)
+			hashmapPlace(this, bucket);
 	}
 
-	nochFree(prev_buckets);
-	return 0;
+	nochFree(prevBuckets);
 }
 
 NOCH_DEF int hashmapSet_(Hashmap *this, const char *key, void *value) {
-	unsigned hash = this->hash(key);
-	size_t   idx  = hash % this->cap;
-
-	HashmapBucket *bucket = HASHMAP_BUCKET_AT(this, idx);
-
-	if (bucket->full && !hashmapBucketMatches(bucket, hash, key)) {
-		bool found = false;
-		for (size_t i = idx + 1; i != idx; ++ i) {
-			if (i >= this->cap)
-				i = 0;
-
-			bucket = HASHMAP_BUCKET_AT(this, i);
-			if (!bucket->full) {
-				found = true;
-				break;
-			}
+	unsigned       hash   = this->hash(key);
+	HashmapBucket *bucket = hashmapProbe(this, hash, key);
+
+	if (bucket->full) {
+		if (this->destruct != NULL)
+			this->destruct(HASHMAP_BUCKET_VAL(bucket));
+	} else {
+		/* Grow before the new key pushes the load past the limit, at least one bucket always
+		   stays empty for the probing to stop at */
+		size_t size = this->size + 1;
+		if ((float)size > (float)this->cap * this->maxLoad || size >= this->cap) {
+			hashmapResize(this, this->cap * 2);
+			bucket = hashmapProbe(this, hash, key);
 		}
 
-		if (!found) {
-			if (hashmapResize(this, this->cap * 2) != 0)
-				return -1;
-
-			hashmapSet_(this, key, value);
-			return 0;
-		}
-	}
-
-	if (!bucket->full)
 		bucket->full = true;
-	else if (this->destruct != NULL)
-		this->destruct(HASHMAP_BUCKET_VAL(bucket));
+		++ this->size;
+	}
 
 	bucket->key  = key;
 	bucket->hash = hash;
@@ -174,3 +196,4 @@ NOCH_DEF int hashmapSet_(Hashmap *this, const char *key, void *value) {
 
 #undef HASHMAP_BUCKET_VAL
 #undef HASHMAP_BUCKET_AT
+#undef HASHMAP_ALIGN_OF
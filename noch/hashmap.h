@@ -21,6 +21,12 @@ NOCH_DEF unsigned hashFuncDefault   (const char *str);
 #	define HASHMAP_DEFAULT_CAP 1024
 #endif
 
+/* The table doubles once more than this fraction of its buckets would be full. Can be changed per
+   map through maxLoad, values past 0.9 make probing slow */
+#ifndef HASHMAP_DEFAULT_MAX_LOAD
+#	define HASHMAP_DEFAULT_MAX_LOAD 0.75f
+#endif
+
 typedef struct {
 	const char *key;
 	unsigned    hash;
@@ -30,9 +36,11 @@ typedef struct {
 typedef unsigned (*HashmapHashFunc)(const char*);
 typedef void     (*HashmapDestructor)(void*);
 
+/* Open addressing with linear probing. The capacity is always a power of two */
 typedef struct {
-	size_t  cap, valueSize, bucketSize;
+	size_t  cap, size, valueSize, bucketSize;
 	void   *buckets;
+	float   maxLoad;
 
 	HashmapHashFunc   hash;
 	HashmapDestructor destruct;
@@ -64,6 +72,7 @@ typedef struct {
 #define hashmapInit(THIS)   hashmapInitEx(THIS, HASHMAP_DEFAULT_CAP, hashFuncDefault, NULL)
 #define hashmapDeinit(THIS) hashmapDeinit_(&(THIS)->base)
 
+#define hashmapSize(THIS)        ((THIS)->base.size)
 #define hashmapRemove(THIS, KEY) hashmapRemove_(&(THIS)->base, KEY)
 #define hashmapGet(THIS, KEY)    ((THIS)->ref = hashmapGet_(&(THIS)->base, KEY))
 #define hashmapSet(THIS, KEY, VAL) \
@@ -4,22 +4,70 @@
 extern "C" {
 #endif
 
+#include <stdio.h> /* snprintf, vsnprintf */
+
 #include "error.h"
 
-static char nochErrorMsg[256] = {0};
+#ifndef NOCH_THREAD_LOCAL
+#	if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#		define NOCH_THREAD_LOCAL _Thread_local
+#	elif defined(_MSC_VER)
+#		define NOCH_THREAD_LOCAL __declspec(thread)
+#	else
+#		define NOCH_THREAD_LOCAL __thread
+#	endif
+#endif
+
+static NOCH_THREAD_LOCAL NochError nochErrorInfo      = {0};
+static NOCH_THREAD_LOCAL char      nochErrorMsg[1024] = {0};
 
 NOCH_DEF const char *nochGetError(void) {
 	return nochErrorMsg;
 }
 
-static int nochError(const char *fmt, ...) {
+NOCH_DEF const NochError *nochGetErrorInfo(void) {
+	return &nochErrorInfo;
+}
+
+NOCH_DEF void nochClearError(void) {
+	nochErrorInfo.code    = NOCH_ERROR_NONE;
+	nochErrorInfo.row     = 0;
+	nochErrorInfo.col     = 0;
+	nochErrorInfo.path[0] = '\0';
+	nochErrorInfo.msg[0]  = '\0';
+	nochErrorMsg[0]       = '\0';
+}
+
+static int nochErrorAt(int code, const char *path, size_t row, size_t col, const char *fmt, ...) {
+	NochError *this = &nochErrorInfo;
+	this->code = code;
+	this->row  = row;
+	this->col  = col;
+	snprintf(this->path, sizeof(this->path), "%s", path == NULL? "" : path);
+
 	va_list args;
 	va_start(args, fmt);
-	vsnprintf(nochErrorMsg, sizeof(nochErrorMsg), fmt, args);
+	vsnprintf(this->msg, sizeof(this->msg), fmt, args);
 	va_end(args);
+
+	/* The position is a column alone if the row is unknown */
+	const char *sep = *this->path == '\0'? "" : ":";
+	if (row > 0)
+		snprintf(nochErrorMsg, sizeof(nochErrorMsg), "%s%s%lu:%lu: %s", this->path, sep,
+		         (long unsigned)row, (long unsigned)col, this->msg);
+	else if (col > 0)
+		snprintf(nochErrorMsg, sizeof(nochErrorMsg), "%s%s%lu: %s", this->path, sep,
+		         (long unsigned)col, this->msg);
+	else if (*this->path != '\0')
+		snprintf(nochErrorMsg, sizeof(nochErrorMsg), "%s: %s", this->path, this->msg);
+	else
+		snprintf(nochErrorMsg, sizeof(nochErrorMsg), "%s", this->msg);
+
 	return -1;
 }
 
+#define nochError(...) nochErrorAt(NOCH_ERROR_INVALID, NULL, 0, 0, __VA_ARGS__)
+
 #ifdef __cplusplus
 }
 #endif
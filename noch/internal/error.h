@@ -4,12 +4,31 @@
 extern "C" {
 #endif
 
-#include <stddef.h> /* NULL */
+#include <stddef.h> /* NULL, size_t */
 #include <stdarg.h> /* va_list, va_start, va_end, vsnprintf */
 
 #include "def.h"
 
-NOCH_DEF const char *nochGetError(void);
+enum {
+	NOCH_ERROR_NONE = 0,
+	NOCH_ERROR_INVALID, /* Invalid argument, missing value or a failed operation */
+	NOCH_ERROR_SYNTAX,  /* Malformed input */
+	NOCH_ERROR_IO,      /* Opening, reading or writing a file failed, or it is empty */
+};
+
+typedef struct {
+	int    code;
+	size_t row, col;  /* Position in the input (from 1), 0 if unknown */
+	char   path[256]; /* File the error comes from, empty if none */
+	char   msg[256];  /* Message without the path and the position */
+} NochError;
+
+/* Errors are kept per thread, so functions failing on different threads do not overwrite each
+   other's errors. Both return the last error of the calling thread, nochGetError formatted as
+   "path:row:col: msg" (leaving out the parts that are unknown) */
+NOCH_DEF const char      *nochGetError    (void);
+NOCH_DEF const NochError *nochGetErrorInfo(void);
+NOCH_DEF void             nochClearError  (void);
 
 #ifdef __cplusplus
 }
@@ -29,102 +29,395 @@ NOCH_DEF Json *jsonNull(void) {
 	return &jsonNullInstance;
 }
 
-static char *jsonStringDup(const char *str) {
-	nochAssert(str != NULL);
+typedef struct JsonArenaBlock {
+	struct JsonArenaBlock *next;
+	size_t                 size, cap;
+} JsonArenaBlock;
+
+#define JSON_ARENA_ALIGN(SIZE)      (((SIZE) + 7) & ~(size_t)7)
+#define JSON_ARENA_BLOCK_DATA(THIS) ((char*)(THIS) + JSON_ARENA_ALIGN(sizeof(JsonArenaBlock)))
+#define JSON_ARENA_BLOCK_MAX        (JSON_ARENA_BLOCK_SIZE * 256) /* Blocks stop growing there */
+
+static JsonArenaBlock *jsonArenaNewBlock(JsonArena *this, size_t cap) {
+	JsonArenaBlock *block = (JsonArenaBlock*)nochAlloc(JSON_ARENA_ALIGN(sizeof(JsonArenaBlock)) + cap);
+	if (block == NULL)
+		NOCH_OUT_OF_MEM();
+
+	block->next = this->head;
+	block->size = 0;
+	block->cap  = cap;
+	this->head  = block;
+	return block;
+}
+
+static void *jsonArenaAlloc(JsonArena *this, size_t size) {
+	size = JSON_ARENA_ALIGN(size);
+
+	JsonArenaBlock *block = this->head;
+	if (block == NULL || block->size + size > block->cap) {
+		/* Grow the blocks geometrically so big documents only need a few of them */
+		size_t cap = block == NULL? JSON_ARENA_BLOCK_SIZE : block->cap * 2;
+		if (cap > JSON_ARENA_BLOCK_MAX)
+			cap = JSON_ARENA_BLOCK_MAX;
+		if (cap < size)
+			cap = size;
+
+		block = jsonArenaNewBlock(this, cap);
+	}
+
+	void *ptr = JSON_ARENA_BLOCK_DATA(block) + block->size;
+	block->size += size;
+	return ptr;
+}
+
+static void *jsonArenaRealloc(JsonArena *this, void *ptr, size_t prevSize, size_t size) {
+	JsonArenaBlock *block = this->head;
+
+	/* The most recent allocation can be grown in place */
+	if (ptr != NULL && block != NULL &&
+	    (char*)ptr + JSON_ARENA_ALIGN(prevSize) == JSON_ARENA_BLOCK_DATA(block) + block->size &&
+	    block->size - JSON_ARENA_ALIGN(prevSize) + JSON_ARENA_ALIGN(size) <= block->cap) {
+		block->size += JSON_ARENA_ALIGN(size) - JSON_ARENA_ALIGN(prevSize);
+		return ptr;
+	} else if (ptr != NULL && size <= prevSize)
+		return ptr;
+
+	void *newPtr = jsonArenaAlloc(this, size);
+	if (ptr != NULL)
+		memcpy(newPtr, ptr, prevSize < size? prevSize : size);
+
+	return newPtr;
+}
 
-	char *ptr = (char*)nochAlloc(strlen(str) + 1);
+static void jsonArenaFree(JsonArena *this) {
+	JsonArenaBlock *block = this->head;
+	while (block != NULL) {
+		JsonArenaBlock *next = block->next;
+		nochFree(block);
+		block = next;
+	}
+
+	this->head = NULL;
+}
+
+/* Allocation helpers, nodes without an arena live on the heap */
+static void *jsonAlloc(JsonArena *arena, size_t size) {
+	if (arena != NULL)
+		return jsonArenaAlloc(arena, size);
+
+	void *ptr = nochAlloc(size);
 	if (ptr == NULL)
 		NOCH_OUT_OF_MEM();
 
-	strcpy(ptr, str);
 	return ptr;
 }
 
-static JsonString *jsonNewString_(char *value) {
-	JsonString *this = (JsonString*)nochAlloc(sizeof(JsonString));
-	if (this == NULL)
+static void *jsonRealloc(JsonArena *arena, void *ptr, size_t prevSize, size_t size) {
+	if (arena != NULL)
+		return jsonArenaRealloc(arena, ptr, prevSize, size);
+
+	ptr = nochRealloc(ptr, size);
+	if (ptr == NULL)
 		NOCH_OUT_OF_MEM();
 
-	this->base.type = JSON_STRING;
-	this->data      = value;
-	this->length    = strlen(value);
-	return this;
+	return ptr;
 }
 
-NOCH_DEF JsonString *jsonNewString(const char *value) {
-	return jsonNewString_(jsonStringDup(value));
+static void jsonFree(JsonArena *arena, void *ptr) {
+	if (arena == NULL)
+		nochFree(ptr);
 }
 
-NOCH_DEF JsonFloat *jsonNewFloat(double value) {
-	JsonFloat *this = (JsonFloat*)nochAlloc(sizeof(JsonFloat));
-	if (this == NULL)
-		NOCH_OUT_OF_MEM();
+static char *jsonStringDup(JsonArena *arena, const char *str) {
+	nochAssert(str != NULL);
+
+	size_t size = strlen(str) + 1;
+	char  *ptr  = (char*)jsonAlloc(arena, size);
+	memcpy(ptr, str, size);
+	return ptr;
+}
 
-	this->base.type = JSON_FLOAT;
-	this->value     = value;
+static Json *jsonNewNode(JsonArena *arena, int type, size_t size) {
+	Json *this  = (Json*)jsonAlloc(arena, size);
+	this->type  = type;
+	this->flags = arena == NULL? 0 : JSON_FLAG_ARENA;
 	return this;
 }
 
-NOCH_DEF JsonInt *jsonNewInt(int64_t value) {
-	JsonInt *this = (JsonInt*)nochAlloc(sizeof(JsonInt));
-	if (this == NULL)
-		NOCH_OUT_OF_MEM();
+/* String data that is copied is stored inline, right after the node */
+#define JSON_STRING_INLINE(THIS) ((char*)(THIS) + sizeof(JsonString))
 
-	this->base.type = JSON_INT;
-	this->value     = value;
+static JsonString *jsonNewString_(JsonArena *arena, char *value, size_t length) {
+	JsonString *this = (JsonString*)jsonNewNode(arena, JSON_STRING, sizeof(JsonString));
+	this->data   = value;
+	this->length = length;
 	return this;
 }
 
-NOCH_DEF JsonBool *jsonNewBool(bool value) {
-	JsonBool *this = (JsonBool*)nochAlloc(sizeof(JsonBool));
-	if (this == NULL)
-		NOCH_OUT_OF_MEM();
+static JsonString *jsonNewStringCopy_(JsonArena *arena, const char *value, size_t length) {
+	JsonString *this = (JsonString*)jsonNewNode(arena, JSON_STRING, sizeof(JsonString) + length + 1);
+	this->data   = JSON_STRING_INLINE(this);
+	this->length = length;
+	memcpy(this->data, value, length);
+	this->data[length] = '\0';
+	return this;
+}
 
-	this->base.type = JSON_BOOL;
-	this->value     = value;
+static JsonFloat *jsonNewFloat_(JsonArena *arena, double value) {
+	JsonFloat *this = (JsonFloat*)jsonNewNode(arena, JSON_FLOAT, sizeof(JsonFloat));
+	this->value = value;
 	return this;
 }
 
-NOCH_DEF JsonList *jsonNewList(void) {
-	JsonList *this = (JsonList*)nochAlloc(sizeof(JsonList));
-	if (this == NULL)
-		NOCH_OUT_OF_MEM();
+static JsonInt *jsonNewInt_(JsonArena *arena, int64_t value) {
+	JsonInt *this = (JsonInt*)jsonNewNode(arena, JSON_INT, sizeof(JsonInt));
+	this->value = value;
+	return this;
+}
 
-	this->base.type = JSON_LIST;
-	this->cap       = JSON_LIST_CHUNK_SIZE;
-	this->size      = 0;
-	this->buf       = (Json**)nochAlloc(this->cap * sizeof(Json*));
-	if (this->buf == NULL)
-		NOCH_OUT_OF_MEM();
+static JsonBool *jsonNewBool_(JsonArena *arena, bool value) {
+	JsonBool *this = (JsonBool*)jsonNewNode(arena, JSON_BOOL, sizeof(JsonBool));
+	this->value = value;
 	return this;
 }
 
-NOCH_DEF JsonObj *jsonNewObj(void) {
-	JsonObj *this = (JsonObj*)nochAlloc(sizeof(JsonObj));
-	if (this == NULL)
-		NOCH_OUT_OF_MEM();
+static JsonList *jsonNewList_(JsonArena *arena) {
+	JsonList *this = (JsonList*)jsonNewNode(arena, JSON_LIST, sizeof(JsonList));
+	this->arena = arena;
+	this->cap   = 0;
+	this->size  = 0;
+	this->buf   = NULL;
+	return this;
+}
 
-	this->base.type = JSON_OBJ;
-	this->cap       = JSON_OBJ_CHUNK_SIZE;
-	this->size      = 0;
-	this->buckets   = (JsonObjBucket*)nochAlloc(this->cap * sizeof(JsonObjBucket));
-	if (this->buckets == NULL)
-		NOCH_OUT_OF_MEM();
+static JsonObj *jsonNewObj_(JsonArena *arena) {
+	JsonObj *this = (JsonObj*)jsonNewNode(arena, JSON_OBJ, sizeof(JsonObj));
+	this->arena    = arena;
+	this->cap      = 0;
+	this->size     = 0;
+	this->index    = NULL;
+	this->indexCap = 0;
+	this->buckets  = NULL;
 	return this;
 }
 
-NOCH_DEF Json **jsonObjAt(JsonObj *this, const char *key) {
-	nochAssert(this != NULL && key != NULL);
+NOCH_DEF JsonString *jsonNewString(const char *value) {
+	nochAssert(value != NULL);
+	return jsonNewStringCopy_(NULL, value, strlen(value));
+}
+
+NOCH_DEF JsonFloat *jsonNewFloat(double value) {
+	return jsonNewFloat_(NULL, value);
+}
+
+NOCH_DEF JsonInt *jsonNewInt(int64_t value) {
+	return jsonNewInt_(NULL, value);
+}
+
+NOCH_DEF JsonBool *jsonNewBool(bool value) {
+	return jsonNewBool_(NULL, value);
+}
+
+NOCH_DEF JsonList *jsonNewList(void) {
+	return jsonNewList_(NULL);
+}
 
+NOCH_DEF JsonObj *jsonNewObj(void) {
+	return jsonNewObj_(NULL);
+}
+
+#define JSON_NPOS (size_t)-1
+
+static unsigned jsonHashKey(const char *key) {
+	unsigned hash = 5381;
+	while (*key != '\0')
+		hash = ((hash << 5) + hash) ^ (unsigned char)*key ++;
+
+	return hash;
+}
+
+/* Same as jsonHashKey for strings without NULs */
+static unsigned jsonHashBytes(const char *key, size_t length) {
+	unsigned hash = 5381;
+	for (size_t i = 0; i < length; ++ i)
+		hash = ((hash << 5) + hash) ^ (unsigned char)key[i];
+
+	return hash;
+}
+
+typedef struct {
+	char    *key;
+	size_t   length;
+	unsigned hash;
+} JsonKey;
+
+/* Open addressing table of the distinct keys of a document, allocated from its arena */
+typedef struct JsonKeys {
+	JsonKey *slots;
+	size_t   cap, size;
+} JsonKeys;
+
+#define JSON_KEYS_MIN_CAP 64
+
+static void jsonKeysInit(JsonArena *arena) {
+	JsonKeys *this = (JsonKeys*)jsonArenaAlloc(arena, sizeof(JsonKeys));
+	this->cap   = JSON_KEYS_MIN_CAP;
+	this->size  = 0;
+	this->slots = (JsonKey*)jsonArenaAlloc(arena, this->cap * sizeof(JsonKey));
+	memset(this->slots, 0, this->cap * sizeof(JsonKey));
+	arena->keys = this;
+}
+
+static JsonKey *jsonKeysFind(JsonKeys *this, const char *key, size_t length, unsigned hash) {
+	size_t mask = this->cap - 1, i = hash & mask;
+	for (; this->slots[i].key != NULL; i = (i + 1) & mask) {
+		JsonKey *slot = this->slots + i;
+		if (slot->hash == hash && slot->length == length && memcmp(slot->key, key, length) == 0)
+			break;
+	}
+
+	return this->slots + i;
+}
+
+/* Returns the arena's copy of a key, which is added if missing. Keys that are not copied (in situ)
+   have to outlive the arena */
+static char *jsonIntern(JsonArena *arena, char *key, size_t length, unsigned hash, bool copy) {
+	JsonKeys *this = arena->keys;
+	JsonKey  *slot = jsonKeysFind(this, key, length, hash);
+	if (slot->key != NULL)
+		return slot->key;
+
+	if (copy) {
+		char *data = (char*)jsonArenaAlloc(arena, length + 1);
+		memcpy(data, key, length);
+		data[length] = '\0';
+		key = data;
+	}
+
+	slot->key    = key;
+	slot->length = length;
+	slot->hash   = hash;
+
+	/* Keep the table at most half full, the old slots are left in the arena */
+	if (++ this->size * 2 > this->cap) {
+		JsonKey *slots = this->slots;
+		size_t   cap   = this->cap;
+
+		this->cap  *= 2;
+		this->slots = (JsonKey*)jsonArenaAlloc(arena, this->cap * sizeof(JsonKey));
+		memset(this->slots, 0, this->cap * sizeof(JsonKey));
+		for (size_t i = 0; i < cap; ++ i) {
+			if (slots[i].key != NULL)
+				*jsonKeysFind(this, slots[i].key, slots[i].length, slots[i].hash) = slots[i];
+		}
+	}
+
+	return key;
+}
+
+static size_t jsonObjFind(JsonObj *this, const char *key, unsigned hash) {
+	if (this->index == NULL) {
+		for (size_t i = 0; i < this->size; ++ i) {
+			JsonObjBucket *bucket = this->buckets + i;
+			if (bucket->key != NULL && bucket->hash == hash &&
+			    (bucket->key == key || strcmp(bucket->key, key) == 0))
+				return i;
+		}
+
+		return JSON_NPOS;
+	}
+
+	/* Slots pointing at removed buckets act as tombstones, so the probe continues past them */
+	size_t mask = this->indexCap - 1;
+	for (size_t i = hash & mask; this->index[i] != 0; i = (i + 1) & mask) {
+		JsonObjBucket *bucket = this->buckets + this->index[i] - 1;
+		if (bucket->key != NULL && bucket->hash == hash &&
+		    (bucket->key == key || strcmp(bucket->key, key) == 0))
+			return this->index[i] - 1;
+	}
+
+	return JSON_NPOS;
+}
+
+static void jsonObjIndexInsert(JsonObj *this, size_t idx) {
+	size_t mask = this->indexCap - 1, i = this->buckets[idx].hash & mask;
+	while (this->index[i] != 0)
+		i = (i + 1) & mask;
+
+	this->index[i] = idx + 1;
+}
+
+static void jsonObjReindex(JsonObj *this, size_t indexCap) {
+	if (this->index == NULL || indexCap != this->indexCap) {
+		jsonFree(this->arena, this->index);
+
+		this->indexCap = indexCap;
+		this->index    = (size_t*)jsonAlloc(this->arena, this->indexCap * sizeof(size_t));
+	}
+
+	memset(this->index, 0, this->indexCap * sizeof(size_t));
 	for (size_t i = 0; i < this->size; ++ i) {
-		if (this->buckets[i].key == NULL)
-			continue;
+		if (this->buckets[i].key != NULL)
+			jsonObjIndexInsert(this, i);
+	}
+}
 
-		if (strcmp(this->buckets[i].key, key) == 0)
-			return &this->buckets[i].value;
+/* Moves the buckets over the holes left by removed keys, keeping them in order */
+static void jsonObjCompact(JsonObj *this) {
+	size_t size = 0;
+	for (size_t i = 0; i < this->size; ++ i) {
+		if (this->buckets[i].key != NULL)
+			this->buckets[size ++] = this->buckets[i];
 	}
 
-	return NULL;
+	if (size == this->size)
+		return;
+
+	this->size = size;
+	if (this->index != NULL)
+		jsonObjReindex(this, this->indexCap);
+}
+
+/* Appends a new bucket without checking for duplicates, takes ownership of the key */
+static Json **jsonObjInsert(JsonObj *this, char *key, unsigned hash, Json *json) {
+	/* Holes are reclaimed before growing, the buffer only grows if it is still over half full */
+	if (this->size >= this->cap) {
+		jsonObjCompact(this);
+
+		if (this->cap == 0 || this->size * 2 > this->cap) {
+			this->cap     = this->cap == 0? JSON_OBJ_CHUNK_SIZE : this->cap * 2;
+			this->buckets = (JsonObjBucket*)jsonRealloc(this->arena, this->buckets,
+			                                            this->size * sizeof(JsonObjBucket),
+			                                            this->cap  * sizeof(JsonObjBucket));
+		}
+	}
+
+	size_t idx = this->size ++;
+	this->buckets[idx].key   = key;
+	this->buckets[idx].hash  = hash;
+	this->buckets[idx].value = json;
+
+	/* Keep the index at most half full. Every bucket (including holes) counts towards the load,
+	   since holes can still occupy slots until the next reindex */
+	if (this->size * 2 > this->indexCap) {
+		if (this->size > JSON_OBJ_INDEX_THRESHOLD) {
+			size_t indexCap = this->indexCap == 0? 16 : this->indexCap * 2;
+			while (indexCap < this->size * 2)
+				indexCap *= 2;
+
+			jsonObjReindex(this, indexCap);
+		}
+	} else
+		jsonObjIndexInsert(this, idx);
+
+	return &this->buckets[idx].value;
+}
+
+NOCH_DEF Json **jsonObjAt(JsonObj *this, const char *key) {
+	nochAssert(this != NULL && key != NULL);
+
+	size_t idx = jsonObjFind(this, key, jsonHashKey(key));
+	return idx == JSON_NPOS? NULL : &this->buckets[idx].value;
 }
 
 NOCH_DEF Json **jsonListAt(JsonList *this, size_t idx) {
@@ -139,803 +432,5070 @@ NOCH_DEF Json **jsonListAt(JsonList *this, size_t idx) {
 NOCH_DEF Json **jsonObjSet_(JsonObj *this, const char *key, Json *json) {
 	nochAssert(this != NULL && key != NULL);
 
-	for (size_t i = 0; i < this->size; ++ i) {
-		if (this->buckets[i].key != NULL) {
-			if (strcmp(this->buckets[i].key, key) != 0)
-				continue;
-		}
+	unsigned hash = jsonHashKey(key);
+	size_t   idx  = jsonObjFind(this, key, hash);
+	if (idx == JSON_NPOS) {
+		char *copy;
+		if (this->arena != NULL && this->arena->keys != NULL)
+			copy = jsonIntern(this->arena, (char*)key, strlen(key), hash, true);
+		else
+			copy = jsonStringDup(this->arena, key);
 
-		if (this->buckets[i].value != NULL)
-			jsonDestroy(this->buckets[i].value);
+		return jsonObjInsert(this, copy, hash, json);
+	}
 
-		if (this->buckets[i].key == NULL)
-			this->buckets[i].key = jsonStringDup(key);
+	if (this->buckets[idx].value != NULL)
+		jsonDestroy(this->buckets[idx].value);
 
-		this->buckets[i].value = json;
-		return &this->buckets[i].value;
-	}
+	this->buckets[idx].value = json;
+	return &this->buckets[idx].value;
+}
 
-	if (this->size >= this->cap) {
-		this->cap    *= 2;
-		this->buckets = (JsonObjBucket*)nochRealloc(this->buckets,
-		                                            this->cap * sizeof(JsonObjBucket));
-		if (this->buckets == NULL)
-			NOCH_OUT_OF_MEM();
-	}
+/* Removes a bucket without destroying its value, which is returned */
+static Json *jsonObjTake(JsonObj *this, size_t idx) {
+	Json *json = this->buckets[idx].value;
 
-	this->buckets[this->size].key   = jsonStringDup(key);
-	this->buckets[this->size].value = json;
-	return &this->buckets[this->size ++].value;
+	jsonFree(this->arena, this->buckets[idx].key);
+	this->buckets[idx].key   = NULL;
+	this->buckets[idx].value = NULL;
+	return json;
 }
 
 NOCH_DEF int jsonObjRemove(JsonObj *this, const char *key) {
 	nochAssert(this != NULL && key != NULL);
 
-	for (size_t i = 0; i < this->size; ++ i) {
-		if (this->buckets[i].key == NULL)
-			continue;
-
-		if (strcmp(this->buckets[i].key, key) == 0) {
-			if (this->buckets[i].value != NULL)
-				jsonDestroy(this->buckets[i].value);
+	size_t idx = jsonObjFind(this, key, jsonHashKey(key));
+	if (idx == JSON_NPOS)
+		return -1;
 
-			free(this->buckets[i].key);
-			this->buckets[i].key   = NULL;
-			this->buckets[i].value = NULL;
-			return 0;
-		}
-	}
+	Json *json = jsonObjTake(this, idx);
+	if (json != NULL)
+		jsonDestroy(json);
 
-	return -1;
+	return 0;
 }
 
 NOCH_DEF Json **jsonListPush_(JsonList *this, Json *json) {
 	nochAssert(this != NULL && json != NULL);
 
 	if (this->size >= this->cap) {
-		this->cap *= 2;
-		this->buf  = (Json**)nochRealloc(this->buf, this->cap * sizeof(Json*));
-		if (this->buf == NULL)
-			NOCH_OUT_OF_MEM();
+		this->cap  = this->cap == 0? JSON_LIST_CHUNK_SIZE : this->cap * 2;
+		this->buf  = (Json**)jsonRealloc(this->arena, this->buf, this->size * sizeof(Json*),
+		                                 this->cap * sizeof(Json*));
 	}
 
 	this->buf[this->size] = json;
 	return this->buf + this->size ++;
 }
 
-NOCH_DEF void jsonListPop(JsonList *this) {
+NOCH_DEF Json **jsonListInsert_(JsonList *this, size_t idx, Json *json) {
+	nochAssert(this != NULL && json != NULL);
+
+	if (idx > this->size)
+		return NULL;
+
+	jsonListPush_(this, json);
+	memmove(this->buf + idx + 1, this->buf + idx, (this->size - 1 - idx) * sizeof(Json*));
+	this->buf[idx] = json;
+	return this->buf + idx;
+}
+
+/* Removes an item without destroying it, which is returned */
+static Json *jsonListTake(JsonList *this, size_t idx) {
+	Json *json = this->buf[idx];
+
+	memmove(this->buf + idx, this->buf + idx + 1, (this->size - 1 - idx) * sizeof(Json*));
+	-- this->size;
+	return json;
+}
+
+NOCH_DEF int jsonListRemove(JsonList *this, size_t idx) {
 	nochAssert(this != NULL);
-	nochAssert(this->size > 0);
 
-	jsonDestroy(this->buf[-- this->size]);
+	if (idx >= this->size)
+		return -1;
+
+	jsonDestroy(jsonListTake(this, idx));
+	return 0;
 }
 
-NOCH_DEF void jsonDestroy_(Json *this) {
+NOCH_DEF void jsonObjShrink(JsonObj *this) {
 	nochAssert(this != NULL);
 
-	switch (this->type) {
-	case JSON_NULL: return;
+	jsonObjCompact(this);
+	if (this->size == 0) {
+		jsonFree(this->arena, this->buckets);
+		this->buckets = NULL;
+		this->cap     = 0;
+	} else if (this->size < this->cap) {
+		this->cap     = this->size;
+		this->buckets = (JsonObjBucket*)jsonRealloc(this->arena, this->buckets,
+		                                            this->size * sizeof(JsonObjBucket),
+		                                            this->cap  * sizeof(JsonObjBucket));
+	}
 
-	case JSON_STRING:
-		nochFree(JSON_STRING(this)->data);
-		break;
+	/* Small objects do not need an index, bigger ones get the smallest one that fits */
+	if (this->size <= JSON_OBJ_INDEX_THRESHOLD) {
+		jsonFree(this->arena, this->index);
+		this->index    = NULL;
+		this->indexCap = 0;
+	} else if (this->index != NULL) {
+		size_t indexCap = 16;
+		while (indexCap < this->size * 2)
+			indexCap *= 2;
+
+		if (indexCap < this->indexCap)
+			jsonObjReindex(this, indexCap);
+	}
+}
 
-	case JSON_FLOAT: case JSON_INT: case JSON_BOOL: break;
+NOCH_DEF void jsonListShrink(JsonList *this) {
+	nochAssert(this != NULL);
 
-	case JSON_LIST: {
-		JsonList *list = JSON_LIST(this);
+	if (this->size == 0) {
+		jsonFree(this->arena, this->buf);
+		this->buf = NULL;
+		this->cap = 0;
+	} else if (this->size < this->cap) {
+		this->cap = this->size;
+		this->buf = (Json**)jsonRealloc(this->arena, this->buf, this->size * sizeof(Json*),
+		                                this->cap * sizeof(Json*));
+	}
+}
 
-		for (size_t i = 0; i < list->size; ++ i)
-			jsonDestroy(list->buf[i]);
+NOCH_DEF void jsonListPop(JsonList *this) {
+	nochAssert(this != NULL);
+	nochAssert(this->size > 0);
 
-		nochFree(list->buf);
-	} break;
+	jsonDestroy(this->buf[-- this->size]);
+}
 
-	case JSON_OBJ: {
-		JsonObj *obj = JSON_OBJ(this);
+/* Doubles the capacity of an explicit stack of full capacity, which starts out in local (on the
+   C stack) and moves to the heap once it outgrows it */
+static void *jsonStackGrow(void *stack, const void *local, size_t *cap, size_t size) {
+	*cap *= 2;
+	if (stack != local)
+		return jsonRealloc(NULL, stack, 0, *cap * size);
 
-		for (size_t i = 0; i < obj->size; ++ i) {
-			if (obj->buckets[i].key == NULL)
-				continue;
+	void *heap = jsonAlloc(NULL, *cap * size);
+	memcpy(heap, local, *cap / 2 * size);
+	return heap;
+}
 
-			if (obj->buckets[i].value != NULL)
-				jsonDestroy(obj->buckets[i].value);
+/* Destroys a node without children, returns false for lists and objects */
+static bool jsonDestroyLeaf(Json *this) {
+	/* Document nodes are released together with their arena */
+	if (this->flags & JSON_FLAG_ARENA)
+		return true;
 
-			nochFree(obj->buckets[i].key);
-		}
+	switch (this->type) {
+	case JSON_NULL: return true;
 
-		nochFree(obj->buckets);
-	} break;
+	case JSON_STRING:
+		if (JSON_STRING(this)->data != JSON_STRING_INLINE(this))
+			nochFree(JSON_STRING(this)->data);
+		break;
+
+	case JSON_FLOAT: case JSON_INT: case JSON_BOOL: break;
+	case JSON_LIST:  case JSON_OBJ:                 return false;
 
 	default: nochAssert(0 && "Unknown JSON type");
 	}
 
 	nochFree(this);
+	return true;
 }
 
+/* Containers waiting to be destroyed, kept on the C stack unless the tree is deeply nested */
+#define JSON_DESTROY_LOCAL_DEPTH 64
+
 typedef struct {
-	FILE  *file;
-	char  *buf;
-	size_t size, cap;
-} JsonOutputStream;
+	Json **stack;
+	size_t depth, cap;
+	Json  *local[JSON_DESTROY_LOCAL_DEPTH];
+} JsonDestroyer;
 
-static void jsonOutput(JsonOutputStream *this, const char *str) {
-	if (this->file != NULL)
-		fprintf(this->file, "%s", str);
-	else {
-		size_t prevSize = this->size;
-		this->size     += strlen(str);
-		if (this->size + 1 >= this->cap) {
-			do
-				this->cap *= 2;
-			while (this->size + 1 >= this->cap);
+static void jsonDestroyerPush(JsonDestroyer *this, Json *json) {
+	if (jsonDestroyLeaf(json))
+		return;
 
-			this->buf = (char*)nochRealloc(this->buf, this->cap);
-			if (this->buf == NULL)
-				NOCH_OUT_OF_MEM();
-		}
+	if (this->depth >= this->cap)
+		this->stack = (Json**)jsonStackGrow(this->stack, this->local, &this->cap, sizeof(Json*));
 
-		strcpy(this->buf + prevSize, str);
-	}
+	this->stack[this->depth ++] = json;
 }
 
-static void jsonOutputFmt(JsonOutputStream *this, const char *fmt, ...) {
-	char    str[256];
-	va_list args;
+NOCH_DEF void jsonDestroy_(Json *this) {
+	nochAssert(this != NULL);
 
-	va_start(args, fmt);
-	vsnprintf(str, sizeof(str), fmt, args);
-	va_end(args);
+	JsonDestroyer destroyer;
+	destroyer.stack = destroyer.local;
+	destroyer.depth = 0;
+	destroyer.cap   = JSON_DESTROY_LOCAL_DEPTH;
 
-	jsonOutput(this, str);
-}
+	jsonDestroyerPush(&destroyer, this);
+	while (destroyer.depth > 0) {
+		Json *json = destroyer.stack[-- destroyer.depth];
 
-static void jsonOutputString(JsonOutputStream *this, JsonString *json) {
-	jsonOutput(this, "\"");
+		/* Children are pushed from the end, so nested containers are popped in their order */
+		if (json->type == JSON_LIST) {
+			JsonList *list = JSON_LIST(json);
+			for (size_t i = list->size; i -- > 0;)
+				jsonDestroyerPush(&destroyer, list->buf[i]);
 
-	for (size_t i = 0; i < json->length; ++ i) {
-		switch (json->data[i]) {
-		case '"':  jsonOutput(this, "\\\""); break;
-		case '\\': jsonOutput(this, "\\\\"); break;
-		case '\b': jsonOutput(this, "\\b");  break;
-		case '\f': jsonOutput(this, "\\f");  break;
-		case '\n': jsonOutput(this, "\\n");  break;
-		case '\r': jsonOutput(this, "\\r");  break;
-		case '\t': jsonOutput(this, "\\t");  break;
+			nochFree(list->buf);
+		} else {
+			JsonObj *obj = JSON_OBJ(json);
+			for (size_t i = obj->size; i -- > 0;) {
+				if (obj->buckets[i].key == NULL)
+					continue;
 
-		default:
-			if ((unsigned char)json->data[i] < 32 || json->data[i] == 127)
-				jsonOutputFmt(this, "\\u%04X", json->data[i]);
-			else
-				jsonOutputFmt(this, "%c", json->data[i]);
+				if (obj->buckets[i].value != NULL)
+					jsonDestroyerPush(&destroyer, obj->buckets[i].value);
+
+				nochFree(obj->buckets[i].key);
+			}
+
+			nochFree(obj->buckets);
+			nochFree(obj->index);
 		}
+
+		nochFree(json);
 	}
 
-	jsonOutput(this, "\"");
+	if (destroyer.stack != destroyer.local)
+		nochFree(destroyer.stack);
 }
 
-static void jsonOutputFloat(JsonOutputStream *this, JsonFloat *json) {
-	char buf[256];
-	snprintf(buf, sizeof(buf), "%.13f", json->value);
+/* Copies a node without children, lists and objects are copied without their items */
+static Json *jsonCloneShallow(JsonArena *arena, Json *this) {
+	switch (this->type) {
+	case JSON_NULL:   return jsonNull();
+	case JSON_STRING: return (Json*)jsonNewStringCopy_(arena, JSON_STRING(this)->data, JSON_STRING(this)->length);
+	case JSON_FLOAT:  return (Json*)jsonNewFloat_(arena, JSON_FLOAT(this)->value);
+	case JSON_INT:    return (Json*)jsonNewInt_  (arena, JSON_INT(this)->value);
+	case JSON_BOOL:   return (Json*)jsonNewBool_ (arena, JSON_BOOL(this)->value);
 
-	bool   found = false;
-	size_t i;
-	for (i = 0; buf[i] != '\0'; ++ i) {
-		if (buf[i] == '.' && !found)
-			found = true;
+	case JSON_LIST: {
+		/* The copy gets exactly the capacity it needs */
+		JsonList *list = jsonNewList_(arena);
+		if (JSON_LIST(this)->size > 0) {
+			list->cap = JSON_LIST(this)->size;
+			list->buf = (Json**)jsonAlloc(arena, list->cap * sizeof(Json*));
+		}
+		return (Json*)list;
 	}
 
-	if (found) {
-		-- i;
-		while (true) {
-			if (buf[i] != '0') {
-				if (buf[i] == '.') {
-					buf[++ i] = '0';
-					buf[++ i] = '\0';
-				}
-
-				break;
-			}
+	case JSON_OBJ: return (Json*)jsonNewObj_(arena);
 
-			buf[i] = '\0';
-			-- i;
-		}
+	default: nochAssert(0 && "Unknown JSON type");
 	}
 
-	jsonOutput(this, buf);
+	return NULL;
 }
 
-static void jsonIndent(JsonOutputStream *this, size_t size) {
-	if (this->file != NULL) {
-		for (size_t i = 0; i < size; ++ i)
-			fprintf(this->file, "\t");
-	} else {
-		size_t prevSize = this->size;
-		this->size     += size;
-		if (this->size + 1 >= this->cap) {
-			do
-				this->cap *= 2;
-			while (this->size + 1 >= this->cap);
+typedef struct {
+	Json *a, *b;
+} JsonPair;
 
-			this->buf = (char*)nochRealloc(this->buf, this->cap);
-			if (this->buf == NULL)
-				NOCH_OUT_OF_MEM();
-		}
+#define JSON_PAIRS_LOCAL_DEPTH 64
 
-		memset(this->buf + prevSize, '\t', size);
-		this->buf[this->size] = '\0';
-	}
-}
+/* Copies the items of the lists and objects on an explicit stack of (source, copy) pairs */
+static Json *jsonCloneInto(JsonArena *arena, Json *this) {
+	JsonPair local[JSON_PAIRS_LOCAL_DEPTH], *stack = local;
+	size_t   depth = 0, cap = JSON_PAIRS_LOCAL_DEPTH;
 
-static void jsonOutputJson(JsonOutputStream *this, Json *json, size_t indentSize, bool comma) {
-	nochAssert(this != NULL && json != NULL);
+	Json *root = jsonCloneShallow(arena, this);
+	if (this->type == JSON_LIST || this->type == JSON_OBJ) {
+		stack[depth].a = this;
+		stack[depth].b = root;
+		++ depth;
+	}
 
-	switch (json->type) {
-	case JSON_NULL:   jsonOutput(this, "null"); break;
-	case JSON_STRING: jsonOutputString(this, JSON_STRING(json)); break;
-	case JSON_FLOAT:  jsonOutputFloat(this,  JSON_FLOAT(json));  break;
-	case JSON_INT:    jsonOutputFmt(this, "%lli", (long long)JSON_INT(json)->value);       break;
-	case JSON_BOOL:   jsonOutputFmt(this, "%s", JSON_BOOL(json)->value? "true" : "false"); break;
+	while (depth > 0) {
+		JsonPair pair = stack[-- depth];
 
-	case JSON_LIST: {
-		JsonList *list = JSON_LIST(json);
+		if (pair.a->type == JSON_LIST) {
+			JsonList *list = JSON_LIST(pair.a);
+			for (size_t i = 0; i < list->size; ++ i) {
+				Json *item = list->buf[i], *copy = jsonCloneShallow(arena, item);
+				jsonListPush(JSON_LIST(pair.b), copy);
 
-		++ indentSize;
-		jsonOutput(this, "[");
-		if (list->size > 0)
-			jsonOutput(this, "\n");
+				if (item->type == JSON_LIST || item->type == JSON_OBJ) {
+					if (depth >= cap)
+						stack = (JsonPair*)jsonStackGrow(stack, local, &cap, sizeof(JsonPair));
 
-		for (size_t i = 0; i < list->size; ++ i) {
-			jsonIndent(this, indentSize);
-			jsonOutputJson(this, list->buf[i], indentSize, i + 1 < list->size);
+					stack[depth].a = item;
+					stack[depth].b = copy;
+					++ depth;
+				}
+			}
+		} else {
+			JsonObj *obj = JSON_OBJ(pair.a);
+			for (size_t i = 0; i < obj->size; ++ i) {
+				JsonObjBucket *bucket = obj->buckets + i;
+				if (bucket->key == NULL)
+					continue;
+
+				char *key;
+				if (arena != NULL && arena->keys != NULL)
+					key = jsonIntern(arena, bucket->key, strlen(bucket->key), bucket->hash, true);
+				else
+					key = jsonStringDup(arena, bucket->key);
+
+				Json *item = bucket->value, *copy = item == NULL? NULL : jsonCloneShallow(arena, item);
+				jsonObjInsert(JSON_OBJ(pair.b), key, bucket->hash, copy);
+
+				if (copy != NULL && (item->type == JSON_LIST || item->type == JSON_OBJ)) {
+					if (depth >= cap)
+						stack = (JsonPair*)jsonStackGrow(stack, local, &cap, sizeof(JsonPair));
+
+					stack[depth].a = item;
+					stack[depth].b = copy;
+					++ depth;
+				}
+			}
 		}
+	}
 
-		jsonIndent(this, -- indentSize);
-		jsonOutput(this, "]");
+	if (stack != local)
+		nochFree(stack);
+	return root;
+}
+
+NOCH_DEF Json *jsonClone_(Json *this) {
+	nochAssert(this != NULL);
+	return jsonCloneInto(NULL, this);
+}
+
+NOCH_DEF Json *jsonDocClone_(JsonDoc *this, Json *json) {
+	nochAssert(this != NULL && json != NULL);
+	return jsonCloneInto(&this->arena, json);
+}
+
+static size_t jsonObjCount(JsonObj *this) {
+	size_t count = 0;
+	for (size_t i = 0; i < this->size; ++ i) {
+		if (this->buckets[i].key != NULL)
+			++ count;
+	}
+
+	return count;
+}
+
+/* An integer equals a float only if the float holds exactly that whole number, without the
+   precision a conversion to double would lose */
+static bool jsonNumberEquals(int64_t integer, double value) {
+	if (!(value >= -9223372036854775808.0 && value < 9223372036854775808.0))
+		return false;
+
+	return (double)(int64_t)value == value && (int64_t)value == integer;
+}
+
+/* With byValue, integers and floats compare as numbers like RFC 6902 tests do */
+static bool jsonEqualsEx(Json *a, Json *b, bool byValue) {
+	JsonPair local[JSON_PAIRS_LOCAL_DEPTH], *stack = local;
+	size_t   depth = 0, cap = JSON_PAIRS_LOCAL_DEPTH;
+	bool     equals = true;
+
+	stack[depth].a = a;
+	stack[depth].b = b;
+	++ depth;
+	while (equals && depth > 0) {
+		JsonPair pair = stack[-- depth];
+		if (pair.a == pair.b)
+			continue;
+		else if (byValue && pair.a != NULL && pair.b != NULL && pair.a->type == JSON_INT &&
+		         pair.b->type == JSON_FLOAT) {
+			equals = jsonNumberEquals(JSON_INT(pair.a)->value, JSON_FLOAT(pair.b)->value);
+			continue;
+		} else if (byValue && pair.a != NULL && pair.b != NULL && pair.a->type == JSON_FLOAT &&
+		           pair.b->type == JSON_INT) {
+			equals = jsonNumberEquals(JSON_INT(pair.b)->value, JSON_FLOAT(pair.a)->value);
+			continue;
+		} else if (pair.a == NULL || pair.b == NULL || pair.a->type != pair.b->type) {
+			equals = false;
+			break;
+		}
+
+		switch (pair.a->type) {
+		case JSON_NULL: break;
+
+		case JSON_STRING:
+			equals = JSON_STRING(pair.a)->length == JSON_STRING(pair.b)->length &&
+			         memcmp(JSON_STRING(pair.a)->data, JSON_STRING(pair.b)->data,
+			                JSON_STRING(pair.a)->length) == 0;
+			break;
+
+		case JSON_FLOAT: equals = JSON_FLOAT(pair.a)->value == JSON_FLOAT(pair.b)->value; break;
+		case JSON_INT:   equals = JSON_INT  (pair.a)->value == JSON_INT  (pair.b)->value; break;
+		case JSON_BOOL:  equals = JSON_BOOL (pair.a)->value == JSON_BOOL (pair.b)->value; break;
+
+		case JSON_LIST: {
+			JsonList *listA = JSON_LIST(pair.a), *listB = JSON_LIST(pair.b);
+			if (listA->size != listB->size) {
+				equals = false;
+				break;
+			}
+
+			for (size_t i = 0; i < listA->size; ++ i) {
+				if (depth >= cap)
+					stack = (JsonPair*)jsonStackGrow(stack, local, &cap, sizeof(JsonPair));
+
+				stack[depth].a = listA->buf[i];
+				stack[depth].b = listB->buf[i];
+				++ depth;
+			}
+		} break;
+
+		case JSON_OBJ: {
+			/* Keys are looked up in the other object, so their order does not matter */
+			JsonObj *objA = JSON_OBJ(pair.a), *objB = JSON_OBJ(pair.b);
+			if (jsonObjCount(objA) != jsonObjCount(objB)) {
+				equals = false;
+				break;
+			}
+
+			for (size_t i = 0; i < objA->size && equals; ++ i) {
+				JsonObjBucket *bucket = objA->buckets + i;
+				if (bucket->key == NULL)
+					continue;
+
+				size_t idx = jsonObjFind(objB, bucket->key, bucket->hash);
+				if (idx == JSON_NPOS) {
+					equals = false;
+					break;
+				}
+
+				if (depth >= cap)
+					stack = (JsonPair*)jsonStackGrow(stack, local, &cap, sizeof(JsonPair));
+
+				stack[depth].a = bucket->value;
+				stack[depth].b = objB->buckets[idx].value;
+				++ depth;
+			}
+		} break;
+
+		default: nochAssert(0 && "Unknown JSON type");
+		}
+	}
+
+	if (stack != local)
+		nochFree(stack);
+	return equals;
+}
+
+NOCH_DEF bool jsonEquals_(Json *a, Json *b) {
+	nochAssert(a != NULL && b != NULL);
+	return jsonEqualsEx(a, b, false);
+}
+
+/* splitmix64 finalizer */
+static uint64_t jsonMix(uint64_t x) {
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+/* FNV-1a */
+static uint64_t jsonHashString(const char *str, size_t length) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (size_t i = 0; i < length; ++ i) {
+		hash ^= (unsigned char)str[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+typedef struct {
+	Json    *json;
+	uint64_t path; /* Hash of the keys and indices leading to the node */
+} JsonHashLevel;
+
+/* The hash is a sum over all nodes of their contents mixed with their path, so it does not depend
+   on the order of object keys and can be computed top down */
+NOCH_DEF uint64_t jsonHash_(Json *this) {
+	nochAssert(this != NULL);
+
+	JsonHashLevel local[JSON_PAIRS_LOCAL_DEPTH], *stack = local;
+	size_t        depth = 0, cap = JSON_PAIRS_LOCAL_DEPTH;
+	uint64_t      hash  = 0;
+
+	stack[depth].json = this;
+	stack[depth].path = 0x9e3779b97f4a7c15ULL;
+	++ depth;
+	while (depth > 0) {
+		JsonHashLevel level = stack[-- depth];
+		Json         *json  = level.json;
+		uint64_t      value = 0;
+
+		switch (json == NULL? JSON_NULL : json->type) {
+		case JSON_NULL: break;
+
+		case JSON_STRING: value = jsonHashString(JSON_STRING(json)->data, JSON_STRING(json)->length); break;
+		case JSON_INT:    value = (uint64_t)JSON_INT(json)->value;                                   break;
+		case JSON_BOOL:   value = JSON_BOOL(json)->value;                                            break;
+
+		case JSON_FLOAT: {
+			/* Equal floats hash the same, 0.0 and -0.0 included */
+			double number = JSON_FLOAT(json)->value == 0? 0 : JSON_FLOAT(json)->value;
+			memcpy(&value, &number, sizeof(value));
+		} break;
+
+		case JSON_LIST: {
+			JsonList *list = JSON_LIST(json);
+			value = list->size;
+
+			for (size_t i = 0; i < list->size; ++ i) {
+				if (depth >= cap)
+					stack = (JsonHashLevel*)jsonStackGrow(stack, local, &cap, sizeof(JsonHashLevel));
+
+				stack[depth].json = list->buf[i];
+				stack[depth].path = jsonMix(level.path + i + 1);
+				++ depth;
+			}
+		} break;
+
+		case JSON_OBJ: {
+			JsonObj *obj = JSON_OBJ(json);
+			FOREACH_IN_JSON_OBJ(obj, member, key, {
+				if (depth >= cap)
+					stack = (JsonHashLevel*)jsonStackGrow(stack, local, &cap, sizeof(JsonHashLevel));
+
+				stack[depth].json = member;
+				stack[depth].path = jsonMix(level.path ^ jsonHashString(key, strlen(key)));
+				++ depth;
+				++ value;
+			});
+		} break;
+
+		default: nochAssert(0 && "Unknown JSON type");
+		}
+
+		int type = json == NULL? JSON_NULL : json->type;
+		hash += jsonMix(level.path ^ jsonMix(value + (uint64_t)type * 0x9e3779b97f4a7c15ULL));
+	}
+
+	if (stack != local)
+		nochFree(stack);
+	return hash;
+}
+
+enum {
+	JSON_OUTPUT_FILE = 0,
+	JSON_OUTPUT_FD,
+	JSON_OUTPUT_STRING, /* Heap string, grown as needed */
+	JSON_OUTPUT_BUFFER, /* Caller's buffer, output that does not fit is only counted */
+};
+
+enum {
+	JSON_PATH_KEY = 0, /* Object key */
+	JSON_PATH_INDEX,   /* List index */
+	JSON_PATH_MEMBER,  /* JSON pointer segment, which is a key or an index depending on the container */
+};
+
+typedef struct {
+	int      type;
+	char    *key;
+	unsigned hash;
+	size_t   idx;     /* JSON_NPOS if a pointer segment is not an index */
+	bool     fromEnd; /* Negative selector index */
+} JsonPathStep;
+
+struct JsonPath {
+	JsonPathStep *steps;
+	size_t        count, cap;
+};
+
+static JsonPathStep *jsonPathPush(JsonPath *this, int type) {
+	if (this->count >= this->cap) {
+		this->cap   = this->cap == 0? 8 : this->cap * 2;
+		this->steps = (JsonPathStep*)jsonRealloc(NULL, this->steps,
+		                                         this->count * sizeof(JsonPathStep),
+		                                         this->cap   * sizeof(JsonPathStep));
+	}
+
+	JsonPathStep *step = this->steps + this->count ++;
+	step->type    = type;
+	step->key     = NULL;
+	step->hash    = 0;
+	step->idx     = JSON_NPOS;
+	step->fromEnd = false;
+	return step;
+}
+
+static void jsonPathSetKey(JsonPathStep *this, const char *key, size_t length) {
+	this->key = (char*)jsonAlloc(NULL, length + 1);
+	memcpy(this->key, key, length);
+	this->key[length] = '\0';
+	this->hash = jsonHashKey(this->key);
+}
+
+/* Returns JSON_NPOS if the digits do not fit */
+static size_t jsonPathParseIndex(const char *it, size_t length) {
+	size_t idx = 0;
+	for (size_t i = 0; i < length; ++ i) {
+		if (idx > (JSON_NPOS - 1 - (it[i] - '0')) / 10)
+			return JSON_NPOS;
+
+		idx = idx * 10 + (it[i] - '0');
+	}
+
+	return idx;
+}
+
+static int jsonPathCompilePointer(JsonPath *this, const char *path) {
+	char  *key = (char*)jsonAlloc(NULL, strlen(path) + 1);
+	size_t col = 1;
+
+	for (const char *it = path; *it != '\0';) {
+		nochAssert(*it == '/');
+		++ it;
+		++ col;
+
+		/* Unescape "~0" and "~1", a segment made of digits (without leading zeros) can also be an
+		   index */
+		size_t length = 0;
+		bool   digits = isdigit(*it) && (it[0] != '0' || it[1] == '/' || it[1] == '\0');
+		for (; *it != '/' && *it != '\0'; ++ it, ++ col) {
+			if (*it == '~') {
+				if (it[1] != '0' && it[1] != '1') {
+					nochFree(key);
+					return nochErrorAt(NOCH_ERROR_SYNTAX, NULL, 0, col,
+					                   "Expected \"~0\" or \"~1\" in JSON pointer");
+				}
+
+				key[length ++] = *++ it == '0'? '~' : '/';
+				digits = false;
+				++ col;
+			} else
+				key[length ++] = *it;
+
+			if (!isdigit(*it))
+				digits = false;
+		}
+
+		JsonPathStep *step = jsonPathPush(this, JSON_PATH_MEMBER);
+		jsonPathSetKey(step, key, length);
+		if (digits)
+			step->idx = jsonPathParseIndex(key, length);
+	}
+
+	nochFree(key);
+	return 0;
+}
+
+static int jsonPathCompileSelector(JsonPath *this, const char *path) {
+	const char *it = path;
+	if (*it == '$')
+		++ it;
+
+	/* A selector can start with a key without the dot (or with a bracket) */
+	bool first = it == path;
+	while (*it != '\0') {
+		size_t col = it - path + 1;
+
+		if (*it == '.' || (first && *it != '[')) {
+			if (*it == '.')
+				++ it;
+
+			const char *start = it;
+			while (*it != '.' && *it != '[' && *it != '\0')
+				++ it;
+
+			if (it == start)
+				return nochErrorAt(NOCH_ERROR_SYNTAX, NULL, 0, col, "Expected a key");
+
+			jsonPathSetKey(jsonPathPush(this, JSON_PATH_KEY), start, it - start);
+		} else if (*it == '[' && it[1] == '"') {
+			it += 2;
+
+			char  *key    = (char*)jsonAlloc(NULL, strlen(it) + 1);
+			size_t length = 0;
+			for (; *it != '"'; ++ it) {
+				if (*it == '\0' || (*it == '\\' && it[1] == '\0')) {
+					nochFree(key);
+					return nochErrorAt(NOCH_ERROR_SYNTAX, NULL, 0, col, "Key not terminated");
+				} else if (*it == '\\')
+					++ it;
+
+				key[length ++] = *it;
+			}
+
+			JsonPathStep *step = jsonPathPush(this, JSON_PATH_KEY);
+			jsonPathSetKey(step, key, length);
+			nochFree(key);
+
+			if (*++ it != ']')
+				return nochErrorAt(NOCH_ERROR_SYNTAX, NULL, 0, it - path + 1, "Expected a \"]\"");
+
+			++ it;
+		} else if (*it == '[') {
+			JsonPathStep *step = jsonPathPush(this, JSON_PATH_INDEX);
+			if (*++ it == '-') {
+				step->fromEnd = true;
+				++ it;
+			}
+
+			const char *start = it;
+			while (isdigit(*it))
+				++ it;
+
+			if (it == start || *it != ']')
+				return nochErrorAt(NOCH_ERROR_SYNTAX, NULL, 0, col, "Expected an index");
+
+			step->idx = jsonPathParseIndex(start, it - start);
+			if (step->idx == JSON_NPOS || (step->fromEnd && step->idx == 0))
+				return nochErrorAt(NOCH_ERROR_SYNTAX, NULL, 0, col, "Invalid index");
+
+			++ it;
+		} else
+			return nochErrorAt(NOCH_ERROR_SYNTAX, NULL, 0, col,
+			                   "Unexpected character \"%c\" in path", *it);
+
+		first = false;
+	}
+
+	return 0;
+}
+
+NOCH_DEF JsonPath *jsonPathCompile(const char *path) {
+	nochAssert(path != NULL);
+
+	JsonPath *this = (JsonPath*)jsonAlloc(NULL, sizeof(JsonPath));
+	this->steps = NULL;
+	this->count = 0;
+	this->cap   = 0;
+
+	/* An empty path is the pointer to the whole document */
+	int ret;
+	if (*path == '/' || *path == '\0')
+		ret = jsonPathCompilePointer(this, path);
+	else
+		ret = jsonPathCompileSelector(this, path);
+
+	if (ret != 0) {
+		jsonPathDestroy(this);
+		return NULL;
+	}
+
+	return this;
+}
+
+NOCH_DEF void jsonPathDestroy(JsonPath *this) {
+	nochAssert(this != NULL);
+
+	for (size_t i = 0; i < this->count; ++ i)
+		nochFree(this->steps[i].key);
+
+	nochFree(this->steps);
+	nochFree(this);
+}
+
+NOCH_DEF Json *jsonPathGet_(const JsonPath *this, Json *json) {
+	nochAssert(this != NULL && json != NULL);
+
+	for (size_t i = 0; i < this->count; ++ i) {
+		const JsonPathStep *step = this->steps + i;
+
+		if (json->type == JSON_OBJ && step->type != JSON_PATH_INDEX) {
+			JsonObj *obj = (JsonObj*)json;
+			size_t   idx = jsonObjFind(obj, step->key, step->hash);
+			if (idx == JSON_NPOS)
+				return NULL;
+
+			json = obj->buckets[idx].value;
+			if (json == NULL)
+				return NULL;
+		} else if (json->type == JSON_LIST && step->type != JSON_PATH_KEY) {
+			JsonList *list = (JsonList*)json;
+			if (step->idx == JSON_NPOS || step->idx > list->size ||
+			    (step->idx == list->size && !step->fromEnd))
+				return NULL;
+
+			json = list->buf[step->fromEnd? list->size - step->idx : step->idx];
+		} else
+			return NULL;
+	}
+
+	return json;
+}
+
+NOCH_DEF Json *jsonQuery_(Json *json, const char *path) {
+	nochAssert(json != NULL && path != NULL);
+
+	JsonPath *compiled = jsonPathCompile(path);
+	if (compiled == NULL)
+		return NULL;
+
+	json = jsonPathGet(compiled, json);
+	jsonPathDestroy(compiled);
+	return json;
+}
+
+/* Output is collected in buf and flushed once it fills up. For strings buf is the result itself,
+   which grows instead of being flushed */
+typedef struct {
+	int    kind;
+	char  *buf;
+	size_t size, cap;
+	size_t flushed; /* Output written before buf */
+	bool   failed;
+	int    indent;  /* JSON_COMPACT, JSON_INDENT_TAB or the number of spaces per level */
+
+	FILE *file;
+	int   fd;
+	char  block[JSON_WRITE_BUFFER_SIZE];
+} JsonOutputStream;
+
+static void jsonOutputInit(JsonOutputStream *this, int kind, int indent) {
+	nochAssert(indent >= JSON_COMPACT);
+
+	this->kind    = kind;
+	this->indent  = indent;
+	this->buf     = this->block;
+	this->size    = 0;
+	this->cap     = sizeof(this->block);
+	this->flushed = 0;
+	this->failed  = false;
+	this->file    = NULL;
+	this->fd      = -1;
+}
+
+/* Makes room for at least one more byte in buf */
+static void jsonOutputFlush(JsonOutputStream *this, size_t need) {
+	switch (this->kind) {
+	case JSON_OUTPUT_FILE:
+		if (!this->failed && fwrite(this->buf, 1, this->size, this->file) != this->size)
+			this->failed = true;
+		break;
+
+	case JSON_OUTPUT_FD:
+#ifdef JSON_POSIX
+		for (size_t written = 0; !this->failed && written < this->size;) {
+			ssize_t ret = write(this->fd, this->buf + written, this->size - written);
+			if (ret > 0)
+				written += ret;
+			else if (ret < 0 && errno != EINTR)
+				this->failed = true;
+		}
+#endif
+		break;
+
+	case JSON_OUTPUT_STRING: {
+		/* One byte is always kept for the terminating NUL */
+		size_t cap = this->cap * 2;
+		while (cap < this->size + need + 1)
+			cap *= 2;
+
+		this->buf = (char*)jsonRealloc(NULL, this->buf, this->size + 1, cap + 1);
+		this->cap = cap;
+	} return;
+
+	case JSON_OUTPUT_BUFFER:
+		/* The caller's buffer is full, the rest of the output is only counted */
+		this->buf = this->block;
+		this->cap = sizeof(this->block);
+		break;
+
+	default: nochAssert(0 && "Unknown output kind");
+	}
+
+	this->flushed += this->size;
+	this->size     = 0;
+}
+
+static void jsonWrite(JsonOutputStream *this, const char *data, size_t size) {
+	while (size > this->cap - this->size) {
+		size_t chunk = this->cap - this->size;
+		memcpy(this->buf + this->size, data, chunk);
+		this->size += chunk;
+		data       += chunk;
+		size       -= chunk;
+
+		jsonOutputFlush(this, size);
+	}
+
+	memcpy(this->buf + this->size, data, size);
+	this->size += size;
+}
+
+static void jsonWriteChar(JsonOutputStream *this, char ch) {
+	if (this->size >= this->cap)
+		jsonOutputFlush(this, 1);
+
+	this->buf[this->size ++] = ch;
+}
+
+#define jsonWriteLiteral(THIS, STR) jsonWrite(THIS, STR, sizeof(STR) - 1)
+
+static void jsonWriteInt(JsonOutputStream *this, int64_t value) {
+	char  buf[24];
+	char *it = buf + sizeof(buf);
+
+	/* Negating INT64_MIN overflows, so the digits are taken from the magnitude as unsigned */
+	uint64_t magnitude = value < 0? (uint64_t)0 - (uint64_t)value : (uint64_t)value;
+	do
+		*-- it = '0' + magnitude % 10;
+	while ((magnitude /= 10) > 0);
+
+	if (value < 0)
+		*-- it = '-';
+
+	jsonWrite(this, it, buf + sizeof(buf) - it);
+}
+
+#define JSON_NEEDS_ESCAPE(CH) ((CH) == '"' || (CH) == '\\' || (CH) < 32 || (CH) == 127)
+
+static void jsonWriteString(JsonOutputStream *this, const char *str, size_t length) {
+	static const char hex[] = "0123456789ABCDEF";
+
+	jsonWriteChar(this, '"');
+
+	/* Runs of characters that need no escaping are written as a whole */
+	const unsigned char *it = (const unsigned char*)str, *end = it + length;
+	while (it < end) {
+		const unsigned char *run = it;
+		while (it < end && !JSON_NEEDS_ESCAPE(*it))
+			++ it;
+
+		jsonWrite(this, (const char*)run, it - run);
+		if (it >= end)
+			break;
+
+		switch (*it) {
+		case '"':  jsonWriteLiteral(this, "\\\""); break;
+		case '\\': jsonWriteLiteral(this, "\\\\"); break;
+		case '\b': jsonWriteLiteral(this, "\\b");  break;
+		case '\f': jsonWriteLiteral(this, "\\f");  break;
+		case '\n': jsonWriteLiteral(this, "\\n");  break;
+		case '\r': jsonWriteLiteral(this, "\\r");  break;
+		case '\t': jsonWriteLiteral(this, "\\t");  break;
+
+		default: {
+			char escaped[6] = {'\\', 'u', '0', '0', hex[*it >> 4], hex[*it & 0xF]};
+			jsonWrite(this, escaped, sizeof(escaped));
+		}
+		}
+
+		++ it;
+	}
+
+	jsonWriteChar(this, '"');
+}
+
+static void jsonWriteFloat(JsonOutputStream *this, double value) {
+	char buf[512];
+	snprintf(buf, sizeof(buf), "%.13f", value);
+
+	bool   found = false;
+	size_t i;
+	for (i = 0; buf[i] != '\0'; ++ i) {
+		if (buf[i] == '.' && !found)
+			found = true;
+	}
+
+	if (found) {
+		-- i;
+		while (true) {
+			if (buf[i] != '0') {
+				if (buf[i] == '.') {
+					buf[++ i] = '0';
+					buf[++ i] = '\0';
+				}
+
+				break;
+			}
+
+			buf[i] = '\0';
+			-- i;
+		}
+	}
+
+	jsonWrite(this, buf, strlen(buf));
+}
+
+static void jsonRepeat(JsonOutputStream *this, char ch, size_t size) {
+	while (size > 0) {
+		if (this->size >= this->cap)
+			jsonOutputFlush(this, size);
+
+		size_t chunk = this->cap - this->size < size? this->cap - this->size : size;
+		memset(this->buf + this->size, ch, chunk);
+		this->size += chunk;
+		size       -= chunk;
+	}
+}
+
+/* Starts a new line indented to the given level, compact output has no line breaks */
+static void jsonNewLineIndent(JsonOutputStream *this, size_t level) {
+	if (this->indent == JSON_COMPACT)
+		return;
+
+	jsonWriteChar(this, '\n');
+	if (this->indent == JSON_INDENT_TAB)
+		jsonRepeat(this, '\t', level);
+	else
+		jsonRepeat(this, ' ', level * this->indent);
+}
+
+static void jsonOutputJson(JsonOutputStream *this, Json *json, size_t indentSize) {
+	nochAssert(this != NULL && json != NULL);
+
+	switch (json->type) {
+	case JSON_NULL:   jsonWriteLiteral(this, "null"); break;
+	case JSON_STRING: jsonWriteString(this, JSON_STRING(json)->data, JSON_STRING(json)->length); break;
+	case JSON_FLOAT:  jsonWriteFloat(this, JSON_FLOAT(json)->value); break;
+	case JSON_INT:    jsonWriteInt(this, JSON_INT(json)->value); break;
+
+	case JSON_BOOL:
+		if (JSON_BOOL(json)->value)
+			jsonWriteLiteral(this, "true");
+		else
+			jsonWriteLiteral(this, "false");
+		break;
+
+	case JSON_LIST: {
+		JsonList *list = JSON_LIST(json);
+
+		jsonWriteChar(this, '[');
+		for (size_t i = 0; i < list->size; ++ i) {
+			if (i > 0)
+				jsonWriteChar(this, ',');
+
+			jsonNewLineIndent(this, indentSize + 1);
+			jsonOutputJson(this, list->buf[i], indentSize + 1);
+		}
+
+		if (list->size > 0)
+			jsonNewLineIndent(this, indentSize);
+		jsonWriteChar(this, ']');
+	} break;
+
+	case JSON_OBJ: {
+		JsonObj *obj   = JSON_OBJ(json);
+		bool     first = true;
+
+		jsonWriteChar(this, '{');
+		FOREACH_IN_JSON_OBJ(obj, value, key, {
+			if (!first)
+				jsonWriteChar(this, ',');
+
+			jsonNewLineIndent(this, indentSize + 1);
+			jsonWriteString(this, key, strlen(key));
+			if (this->indent == JSON_COMPACT)
+				jsonWriteChar(this, ':');
+			else
+				jsonWriteLiteral(this, ": ");
+			jsonOutputJson(this, value, indentSize + 1);
+			first = false;
+		});
+
+		if (!first)
+			jsonNewLineIndent(this, indentSize);
+		jsonWriteChar(this, '}');
+	} break;
+
+	default: nochAssert(0 && "Unknown JSON type");
+	}
+}
+
+/* Pretty output ends with a new line */
+static void jsonOutputRoot(JsonOutputStream *this, Json *json) {
+	jsonOutputJson(this, json, 0);
+	if (this->indent != JSON_COMPACT)
+		jsonWriteChar(this, '\n');
+}
+
+NOCH_DEF void jsonPrintF_(Json *this, FILE *file) {
+	jsonPrintFEx_(this, file, JSON_INDENT_TAB);
+}
+
+NOCH_DEF char *jsonStringify_(Json *this) {
+	return jsonStringifyEx_(this, JSON_INDENT_TAB);
+}
+
+NOCH_DEF void jsonPrintFEx_(Json *this, FILE *file, int indent) {
+	nochAssert(this != NULL && file != NULL);
+
+	JsonOutputStream outputStream;
+	jsonOutputInit(&outputStream, JSON_OUTPUT_FILE, indent);
+	outputStream.file = file;
+
+	jsonOutputRoot(&outputStream, this);
+	jsonOutputFlush(&outputStream, 0);
+}
+
+#ifdef JSON_POSIX
+NOCH_DEF int jsonPrintFdEx_(Json *this, int fd, int indent) {
+	nochAssert(this != NULL && fd >= 0);
+
+	JsonOutputStream outputStream;
+	jsonOutputInit(&outputStream, JSON_OUTPUT_FD, indent);
+	outputStream.fd = fd;
+
+	jsonOutputRoot(&outputStream, this);
+	jsonOutputFlush(&outputStream, 0);
+	return outputStream.failed? -1 : 0;
+}
+#endif
+
+NOCH_DEF char *jsonStringifyEx_(Json *this, int indent) {
+	nochAssert(this != NULL);
+
+	JsonOutputStream outputStream;
+	jsonOutputInit(&outputStream, JSON_OUTPUT_STRING, indent);
+	outputStream.cap = 256;
+	outputStream.buf = (char*)jsonAlloc(NULL, outputStream.cap + 1);
+
+	jsonOutputRoot(&outputStream, this);
+
+	outputStream.buf[outputStream.size] = '\0';
+	return outputStream.buf;
+}
+
+NOCH_DEF size_t jsonStringifyToEx_(Json *this, char *buf, size_t size, int indent) {
+	nochAssert(this != NULL && (buf != NULL || size == 0));
+
+	JsonOutputStream outputStream;
+	jsonOutputInit(&outputStream, JSON_OUTPUT_BUFFER, indent);
+	if (size > 0) {
+		outputStream.buf = buf;
+		outputStream.cap = size - 1;
+	}
+
+	jsonOutputRoot(&outputStream, this);
+
+	size_t length = outputStream.flushed + outputStream.size;
+	if (size > 0)
+		buf[length < size? length : size - 1] = '\0';
+
+	return length;
+}
+
+typedef struct {
+	const char *in, *it, *bol; /* input, iterator, beginning of line */
+	const char *end;           /* End of the input if known, a NUL before it is an error */
+	size_t      row, colBase;  /* colBase counts the columns of the line dropped before bol */
+	const char *path;
+	JsonArena  *arena;   /* NULL when parsing into heap nodes */
+	int         strings; /* Where unescaped strings are stored */
+
+	char  *scratch; /* Reused buffer for JSON_STRINGS_SCRATCH */
+	size_t scratchCap;
+
+	/* With partial input, more may follow after the terminating NUL. Running into the end inside
+	   of a token then sets needMore to the character that could complete it (-1 for any) instead
+	   of reporting an error */
+	bool partial;
+	int  needMore;
+
+	bool quiet; /* Errors are not reported, for workers whose errors would not reach the caller */
+
+	/* Rows and columns are counted from here instead of the start of the input. The position of the
+	   origin itself is only worked out when an error is reported */
+	const char *origin;
+} JsonParser;
+
+enum {
+	JSON_STRINGS_ALLOC = 0, /* Allocated from the parser's arena or the heap */
+	JSON_STRINGS_IN_SITU,   /* Unescaped in place, the input is writable */
+	JSON_STRINGS_SCRATCH,   /* Unescaped into the scratch buffer, valid until the next string */
+};
+
+#define JSON_COL(THIS) ((size_t)((THIS)->it - (THIS)->bol) + (THIS)->colBase + 1)
+
+/* Turns a position counted from the origin into one counted from the start of the input */
+static void jsonPosition(JsonParser *this, size_t *row, size_t *col) {
+	if (this->origin == NULL)
+		return;
+
+	size_t      originRow = 1;
+	const char *bol       = this->in;
+	for (const char *it = this->in; it < this->origin; ++ it) {
+		if (*it == '\n') {
+			++ originRow;
+			bol = it + 1;
+		}
+	}
+
+	if (*row == 1)
+		*col += this->origin - bol;
+
+	*row += originRow - 1;
+}
+
+static int jsonErrorCode(JsonParser *this, int code, size_t row, size_t col, const char *fmt, ...) {
+	if (this->quiet)
+		return -1;
+
+	char    str[256];
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(str, sizeof(str), fmt, args);
+	va_end(args);
+
+	jsonPosition(this, &row, &col);
+	return nochErrorAt(code, this->path, row, col, "%s", str);
+}
+
+#define jsonError(THIS, ROW, COL, ...) jsonErrorCode(THIS, NOCH_ERROR_SYNTAX, ROW, COL, __VA_ARGS__)
+
+static int jsonNeedMore(JsonParser *this, int awaiting) {
+	this->needMore = awaiting;
+	return -1;
+}
+
+static void jsonNewLine(JsonParser *this) {
+	++ this->row;
+	this->bol     = this->it + 1;
+	this->colBase = 0;
+}
+
+/* Not standard!!!! but very useful */
+static int jsonSkipComment(JsonParser *this) {
+	nochAssert(*this->it == '/' && this->it[1] == '*');
+
+	size_t row = this->row, col = JSON_COL(this);
+
+	this->it += 2;
+	while (true) {
+		if (*this->it == '\n')
+			jsonNewLine(this);
+		else if (*this->it == '\0') {
+			if (this->partial)
+				return jsonNeedMore(this, '/');
+
+			return jsonError(this, row, col, "Comment not terminated");
+		}
+		else if (*this->it == '*' && this->it[1] == '/')
+			break;
+
+		++ this->it;
+	}
+
+	this->it += 2;
+	return 0;
+}
+
+#if defined(JSON_AVX2)
+#	define JSON_SIMD_WIDTH 32
+
+typedef __m256i JsonSimd;
+
+#	define jsonSimdLoad(PTR) _mm256_load_si256((const __m256i*)(PTR))
+#	define jsonSimdSet(CH)   _mm256_set1_epi8(CH)
+#	define jsonSimdEq(A, B)  _mm256_cmpeq_epi8(A, B)
+#	define jsonSimdOr(A, B)  _mm256_or_si256(A, B)
+#	define jsonSimdMask(A)   (uint32_t)_mm256_movemask_epi8(A)
+#elif defined(JSON_SSE2)
+#	define JSON_SIMD_WIDTH 16
+
+typedef __m128i JsonSimd;
+
+#	define jsonSimdLoad(PTR) _mm_load_si128((const __m128i*)(PTR))
+#	define jsonSimdSet(CH)   _mm_set1_epi8(CH)
+#	define jsonSimdEq(A, B)  _mm_cmpeq_epi8(A, B)
+#	define jsonSimdOr(A, B)  _mm_or_si128(A, B)
+#	define jsonSimdMask(A)   (uint32_t)_mm_movemask_epi8(A)
+#endif
+
+/* Aligned blocks never cross into the next page, so reading the rest of the block after the
+   terminating NUL can not fault. It is still outside of the string, which the address sanitizer
+   would report */
+#ifdef JSON_SIMD_WIDTH
+#	if defined(__SANITIZE_ADDRESS__)
+#		define JSON_SIMD_SCAN static __attribute__((no_sanitize_address))
+#	elif defined(__has_feature)
+#		if __has_feature(address_sanitizer)
+#			define JSON_SIMD_SCAN static __attribute__((no_sanitize_address))
+#		endif
+#	endif
+#endif
+
+#ifndef JSON_SIMD_SCAN
+#	define JSON_SIMD_SCAN static
+#endif
+
+#define JSON_IS_STRING_SPECIAL(CH) \
+	((CH) == '"' || (CH) == '\\' || (CH) == '\n' || (CH) == '\0')
+
+/* Returns the first '"', '\\', '\n' or NUL */
+JSON_SIMD_SCAN const char *jsonScanString(const char *it) {
+#ifdef JSON_SIMD_WIDTH
+	for (; (uintptr_t)it % JSON_SIMD_WIDTH != 0; ++ it) {
+		if (JSON_IS_STRING_SPECIAL(*it))
+			return it;
+	}
+
+	JsonSimd quote = jsonSimdSet('"'), backslash = jsonSimdSet('\\');
+	JsonSimd lf    = jsonSimdSet('\n'), nul      = jsonSimdSet('\0');
+	for (;; it += JSON_SIMD_WIDTH) {
+		JsonSimd block = jsonSimdLoad(it);
+		uint32_t mask  = jsonSimdMask(jsonSimdOr(jsonSimdOr(jsonSimdEq(block, quote),
+		                                                    jsonSimdEq(block, backslash)),
+		                                         jsonSimdOr(jsonSimdEq(block, lf),
+		                                                    jsonSimdEq(block, nul))));
+		if (mask != 0)
+			return it + __builtin_ctz(mask);
+	}
+#else
+	while (!JSON_IS_STRING_SPECIAL(*it))
+		++ it;
+
+	return it;
+#endif
+}
+
+/* Skips spaces, tabs, carriage returns and new lines */
+JSON_SIMD_SCAN void jsonSkipWhitespaces(JsonParser *this) {
+	const char *it = this->it;
+
+#ifdef JSON_SIMD_WIDTH
+	for (; (uintptr_t)it % JSON_SIMD_WIDTH != 0; ++ it) {
+		if (*it == '\n') {
+			this->it = it;
+			jsonNewLine(this);
+		} else if (*it != ' ' && *it != '\t' && *it != '\r')
+			goto done;
+	}
+
+	JsonSimd space = jsonSimdSet(' '),  tab = jsonSimdSet('\t');
+	JsonSimd cr    = jsonSimdSet('\r'), lf  = jsonSimdSet('\n');
+	for (;; it += JSON_SIMD_WIDTH) {
+		JsonSimd block = jsonSimdLoad(it);
+		JsonSimd nl    = jsonSimdEq(block, lf);
+		uint32_t lines = jsonSimdMask(nl);
+		uint32_t other = ~jsonSimdMask(jsonSimdOr(jsonSimdOr(jsonSimdEq(block, space),
+		                                                     jsonSimdEq(block, tab)),
+		                                          jsonSimdOr(jsonSimdEq(block, cr), nl)));
+		if (JSON_SIMD_WIDTH < 32)
+			other &= (1u << (JSON_SIMD_WIDTH % 32)) - 1;
+
+		/* Only the new lines before the first other character are skipped */
+		size_t skipped = other == 0? JSON_SIMD_WIDTH : (size_t)__builtin_ctz(other);
+		if (skipped < 32)
+			lines &= (1u << skipped) - 1;
+
+		if (lines != 0) {
+			this->row    += __builtin_popcount(lines);
+			this->bol     = it + 32 - __builtin_clz(lines);
+			this->colBase = 0;
+		}
+
+		if (other != 0) {
+			it += skipped;
+			break;
+		}
+	}
+
+done:
+#else
+	for (; *it == ' ' || *it == '\t' || *it == '\r' || *it == '\n'; ++ it) {
+		if (*it == '\n') {
+			this->it = it;
+			jsonNewLine(this);
+		}
+	}
+#endif
+
+	this->it = it;
+}
+
+static int jsonSkipWhitespacesAndComments(JsonParser *this) {
+	while (true) {
+		jsonSkipWhitespaces(this);
+
+		if (*this->it == '/' && this->it[1] == '*') {
+			if (jsonSkipComment(this) != 0)
+				return -1;
+		} else if (*this->it == '/' && this->it[1] == '\0' && this->partial)
+			return jsonNeedMore(this, -1);
+		else if (*this->it != '\0' && isspace(*this->it))
+			++ this->it; /* Vertical tabs and form feeds */
+		else
+			break;
+	}
+	return 0;
+}
+
+static int jsonParseHex4(JsonParser *this, uint16_t *ret) {
+	nochAssert(ret != NULL);
+
+	char buf[5] = {0};
+	for (size_t i = 0; i < 4; ++ i) {
+		if (!isxdigit(*this->it))
+			return jsonError(this, this->row, JSON_COL(this),
+			                 "Expected 4 hexadecimal digits, got \"%c\"", *this->it);
+
+		buf[i] = *this->it ++;
+	}
+
+	*ret = strtol(buf, NULL, 16);
+	return 0;
+}
+
+static int jsonParseUnicodeSequence(JsonParser *this, char *str, size_t *end) {
+	size_t col = JSON_COL(this) - 1;
+	++ this->it;
+
+	uint32_t rune;
+	uint16_t first, second;
+	if (jsonParseHex4(this, &first) != 0)
+		return -1;
+
+	/* Surrogate pair */
+	if (first >= 0xD800 && first <= 0xDBFF) {
+		if (*this->it == '\0')
+			return jsonError(this, this->row, col, "Expected a surrogate pair");
+
+		if (this->it[0] != '\\' || this->it[1] != 'u')
+			return jsonError(this, this->row, col, "Invalid unicode sequence");
+
+		this->it += 2;
+		if (jsonParseHex4(this, &second) != 0)
+			return -1;
+
+		if (second < 0xDC00 || second > 0xDFFF)
+			return jsonError(this, this->row, col, "Invalid unicode sequence");
+
+		rune = 0x10000 + (((first & 0x3FF) << 10) | (second & 0x3FF));
+	} else
+		rune = first;
+
+	char out[5] = {0};
+
+	if (rune <= 0x7F)
+		out[0] = rune;
+	else if (rune <= 0x7FF) {
+		out[0] = (0xC0 | (rune >> 6));   /* 110xxxxx */
+		out[1] = (0x80 | (rune & 0x3F)); /* 10xxxxxx */
+	} else if (rune <= 0xFFFF) {
+		out[0] = (0xE0 | (rune >> 12));       /* 1110xxxx */
+		out[1] = (0x80 | (rune >> 6 & 0x3F)); /* 10xxxxxx */
+		out[2] = (0x80 | (rune & 0x3F));      /* 10xxxxxx */
+	} else if (rune <= 0x10FFFF) {
+		out[0] = 0xF0 | (rune >> 18);        /* 11110xxx */
+		out[1] = 0x80 | (rune >> 12 & 0x3F); /* 10xxxxxx */
+		out[2] = 0x80 | (rune >> 6  & 0x3F); /* 10xxxxxx */
+		out[3] = 0x80 | (rune & 0x3F);       /* 10xxxxxx */
+	} else
+		return jsonError(this, this->row, col, "Invalid unicode sequence");
+
+	for (const char *it = out; *it != '\0'; ++ it)
+		str[(*end) ++] = *it;
+
+    return 0;
+}
+
+/* Moves past the closing quote of a string without unescaping it */
+static int jsonSkipString(JsonParser *this, bool *hasEscapes) {
+	nochAssert(*this->it == '"');
+
+	size_t col = JSON_COL(this);
+
+	*hasEscapes = false;
+	++ this->it;
+	while (true) {
+		this->it = jsonScanString(this->it);
+		if (*this->it == '"')
+			break;
+		else if (*this->it == '\\') {
+			/* The escaped character is skipped, unless it ends the string early */
+			*hasEscapes = true;
+			this->it   += this->it[1] == '\0' || this->it[1] == '\n'? 1 : 2;
+		} else if (*this->it == '\0' && this->partial)
+			return jsonNeedMore(this, '"');
+		else
+			return jsonError(this, this->row, col, "String not terminated");
+	}
+
+	++ this->it;
+	return 0;
+}
+
+static char *jsonEscapeString(JsonParser *this, size_t *length) {
+	const char *start = this->it + 1;
+	bool        hasEscapes;
+	if (jsonSkipString(this, &hasEscapes) != 0)
+		return NULL;
+
+	/* Unescaping never makes a string longer, so in situ the result can overwrite the source */
+	size_t size = this->it - 1 - start;
+	char  *str;
+	switch (this->strings) {
+	case JSON_STRINGS_IN_SITU: str = (char*)start; break;
+
+	case JSON_STRINGS_SCRATCH:
+		if (size + 1 > this->scratchCap) {
+			this->scratchCap = size + 1 > this->scratchCap * 2? size + 1 : this->scratchCap * 2;
+			this->scratch    = (char*)jsonRealloc(NULL, this->scratch, 0, this->scratchCap);
+		}
+
+		str = this->scratch;
+		break;
+
+	default: str = (char*)jsonAlloc(this->arena, size + 1);
+	}
+
+	if (!hasEscapes) {
+		if (this->strings != JSON_STRINGS_IN_SITU)
+			memcpy(str, start, size);
+
+		str[size] = '\0';
+		*length   = size;
+		return str;
+	}
+
+	/* Runs of characters between the escapes are copied as a whole */
+	size_t end = 0;
+	this->it   = start;
+	while (true) {
+		const char *run = this->it;
+		this->it = jsonScanString(this->it);
+
+		memmove(str + end, run, this->it - run);
+		end += this->it - run;
+		if (*this->it == '"')
+			break;
+
+		nochAssert(*this->it == '\\');
+		++ this->it;
+
+		char escaped;
+		switch (*this->it) {
+		case '"': case '\\': case '/':
+			escaped = *this->it;
+			break;
+
+		case 'b': escaped = '\b';   break;
+		case 'f': escaped = '\f';   break;
+		case 'n': escaped = '\n';   break;
+		case 'r': escaped = '\r';   break;
+		case 't': escaped = '\t';   break;
+		case 'e': escaped = '\x1b'; break; /* Not standard!!!! but useful */
+
+		case 'u':
+			if (jsonParseUnicodeSequence(this, str, &end) != 0) {
+				if (this->strings == JSON_STRINGS_ALLOC)
+					jsonFree(this->arena, str);
+				return NULL;
+			}
+			continue;
+
+		default:
+			jsonError(this, this->row, JSON_COL(this),
+			          "Unknown escape sequence \"\\%c\"", *this->it);
+			if (this->strings == JSON_STRINGS_ALLOC)
+				jsonFree(this->arena, str);
+			return NULL;
+		}
+
+		str[end ++] = escaped;
+		++ this->it;
+	}
+
+	++ this->it;
+	str[end] = '\0';
+	*length  = end;
+	return str;
+}
+
+static bool stringViewEqualsString(const char *view, size_t len, const char *str) {
+	if (strncmp(view, str, len) != 0)
+		return false;
+	else
+		return strlen(str) == len;
+}
+
+/* Returns JSON_NULL or JSON_BOOL (with the value in *value), or -1 on error */
+static int jsonLexId(JsonParser *this, bool *value) {
+	nochAssert(isalpha(*this->it));
+
+	size_t col = JSON_COL(this);
+
+	const char *start = this->it;
+	if (this->partial) {
+		const char *it = start;
+		while (isalnum(*it))
+			++ it;
+
+		if (*it == '\0')
+			return jsonNeedMore(this, -1);
+	}
+
+	while (isalnum(*this->it ++));
+
+	size_t len = -- this->it - start;
+	if (stringViewEqualsString(start, len, "null"))
+		return JSON_NULL;
+	else if (stringViewEqualsString(start, len, "true")) {
+		*value = true;
+		return JSON_BOOL;
+	} else if (stringViewEqualsString(start, len, "false")) {
+		*value = false;
+		return JSON_BOOL;
+	}
+
+	return jsonError(this, this->row, col, "Unknown identifier \"%.*s\"", (int)len, start);
+}
+
+static Json *jsonParseId(JsonParser *this) {
+	bool value;
+	switch (jsonLexId(this, &value)) {
+	case JSON_NULL: return jsonNull();
+	case JSON_BOOL: return (Json*)jsonNewBool_(this->arena, value);
+	default:        return NULL;
+	}
+}
+
+static Json *jsonParseString(JsonParser *this) {
+	if (this->strings == JSON_STRINGS_IN_SITU) {
+		size_t length;
+		char  *str = jsonEscapeString(this, &length);
+		return str == NULL? NULL : (Json*)jsonNewString_(this->arena, str, length);
+	}
+
+	/* Unescape into the scratch buffer first, so the string can be stored inline with its node */
+	int strings   = this->strings;
+	this->strings = JSON_STRINGS_SCRATCH;
+
+	size_t length;
+	char  *str = jsonEscapeString(this, &length);
+	this->strings = strings;
+	return str == NULL? NULL : (Json*)jsonNewStringCopy_(this->arena, str, length);
+}
+
+/* Powers of ten that are exact doubles */
+static const double jsonPow10[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+#define JSON_MAX_EXACT_MANTISSA ((uint64_t)1 << 53)
+#define JSON_MAX_EXPONENT       100000 /* Way past the range of double, bigger exponents are clamped */
+
+typedef struct {
+	const char *intStart, *intEnd, *fracStart, *fracEnd;
+	bool        negative;
+	long        exponent;
+} JsonNumber;
+
+/* strtod is correctly rounded, but it reads the decimal point of the current locale. The digits
+   are passed to it without one, with the fraction moved into the exponent */
+static double jsonNumberToFloatSlow(JsonNumber *number) {
+	size_t intLength  = number->intEnd  - number->intStart;
+	size_t fracLength = number->fracEnd - number->fracStart;
+
+	char   small[128];
+	size_t size = intLength + fracLength + 32;
+	char  *buf  = size <= sizeof(small)? small : (char*)jsonAlloc(NULL, size);
+	char  *it   = buf;
+
+	if (number->negative)
+		*it ++ = '-';
+
+	memcpy(it, number->intStart, intLength);
+	it += intLength;
+	memcpy(it, number->fracStart, fracLength);
+	it += fracLength;
+
+	snprintf(it, size - (it - buf), "e%li", number->exponent - (long)fracLength);
+
+	double value = strtod(buf, NULL);
+	if (buf != small)
+		nochFree(buf);
+
+	return value;
+}
+
+/* Returns JSON_INT or JSON_FLOAT (with the value in *intValue or *floatValue), or -1 on error.
+   Integers that do not fit into int64_t become floats */
+static int jsonLexNumber(JsonParser *this, int64_t *intValue, double *floatValue) {
+	nochAssert(isdigit(*this->it) || *this->it == '-');
+
+	if (this->partial) {
+		const char *it = this->it;
+		while (isalnum(*it) || *it == '.' || *it == '-' || *it == '+')
+			++ it;
+
+		if (*it == '\0')
+			return jsonNeedMore(this, -1);
+	}
+
+	JsonNumber number = {0};
+	if (*this->it == '-') {
+		number.negative = true;
+		++ this->it;
+		if (!isdigit(*this->it))
+			return jsonError(this, this->row, JSON_COL(this), "Expected a number after \"-\"");
+	}
+
+	/* The significant digits are collected into the mantissa while it can hold them, the digits
+	   after that only move the decimal exponent */
+	uint64_t mantissa  = 0;
+	long     exponent  = 0;
+	bool     truncated = false;
+
+	number.intStart = this->it;
+	for (; isdigit(*this->it); ++ this->it) {
+		if (mantissa <= (UINT64_MAX - 9) / 10)
+			mantissa = mantissa * 10 + (*this->it - '0');
+		else {
+			truncated = true;
+			++ exponent;
+		}
+	}
+	number.intEnd    = this->it;
+	number.fracStart = number.fracEnd = this->it;
+
+	bool floatingPoint = *this->it == '.';
+	if (floatingPoint) {
+		if (!isdigit(this->it[1]))
+			return jsonError(this, this->row, JSON_COL(this),
+			                 "expected a digit after floating point");
+
+		number.fracStart = ++ this->it;
+		for (; isdigit(*this->it); ++ this->it) {
+			if (mantissa <= (UINT64_MAX - 9) / 10) {
+				mantissa = mantissa * 10 + (*this->it - '0');
+				-- exponent;
+			} else
+				truncated = true;
+		}
+		number.fracEnd = this->it;
+	}
+
+	bool hasExponent = *this->it == 'e' || *this->it == 'E';
+	if (hasExponent) {
+		bool negativeExponent = false;
+		if (this->it[1] == '+' || this->it[1] == '-')
+			negativeExponent = *++ this->it == '-';
+
+		if (!isdigit(this->it[1]))
+			return jsonError(this, this->row, JSON_COL(this), "expected a digit after exponent");
+
+		++ this->it;
+		for (; isdigit(*this->it); ++ this->it) {
+			if (number.exponent < JSON_MAX_EXPONENT)
+				number.exponent = number.exponent * 10 + (*this->it - '0');
+		}
+
+		if (negativeExponent)
+			number.exponent = -number.exponent;
+	}
+
+	if (*this->it == '.') {
+		if (hasExponent)
+			return jsonError(this, this->row, JSON_COL(this),
+			                 "Unexpected floating point in exponent");
+		else
+			return jsonError(this, this->row, JSON_COL(this),
+			                 "Encountered floating point in number twice");
+	} else if (hasExponent && (*this->it == 'e' || *this->it == 'E'))
+		return jsonError(this, this->row, JSON_COL(this), "Encountered exponent in number twice");
+	else if (*this->it == '-' || isalpha(*this->it))
+		return jsonError(this, this->row, JSON_COL(this),
+		                 "Unexpected character \"%c\" in number", *this->it);
+
+	if (!floatingPoint && !hasExponent && !truncated) {
+		if (!number.negative && mantissa <= (uint64_t)INT64_MAX) {
+			*intValue = (int64_t)mantissa;
+			return JSON_INT;
+		} else if (number.negative && mantissa <= (uint64_t)INT64_MAX + 1) {
+			*intValue = mantissa == 0? 0 : -(int64_t)(mantissa - 1) - 1;
+			return JSON_INT;
+		}
+	}
+
+	/* Both the mantissa and the power of ten are exact doubles, so a single multiplication or
+	   division rounds correctly. Excess precision in intermediate results (x87) would break that */
+	exponent += number.exponent;
+#if FLT_EVAL_METHOD == 0
+	if (!truncated && mantissa <= JSON_MAX_EXACT_MANTISSA &&
+	    exponent >= -22 && exponent <= 22) {
+		double value = (double)mantissa;
+		if (exponent < 0)
+			value /= jsonPow10[-exponent];
+		else
+			value *= jsonPow10[exponent];
+
+		*floatValue = number.negative? -value : value;
+		return JSON_FLOAT;
+	}
+#endif
+
+	*floatValue = jsonNumberToFloatSlow(&number);
+	return JSON_FLOAT;
+}
+
+static Json *jsonParseNumber(JsonParser *this) {
+	int64_t intValue;
+	double  floatValue;
+	switch (jsonLexNumber(this, &intValue, &floatValue)) {
+	case JSON_INT:   return (Json*)jsonNewInt_  (this->arena, intValue);
+	case JSON_FLOAT: return (Json*)jsonNewFloat_(this->arena, floatValue);
+	default:         return NULL;
+	}
+}
+
+static Json *jsonParseScalar(JsonParser *this) {
+	switch (*this->it) {
+	case '\0':
+		jsonError(this, this->row, JSON_COL(this), "Unexpected end of input");
+		return NULL;
+
+	case '"': return jsonParseString(this);
+
+	default:
+		if (isdigit(*this->it) || *this->it == '-')
+			return jsonParseNumber(this);
+		else if (isalpha(*this->it))
+			return jsonParseId(this);
+
+		jsonError(this, this->row, JSON_COL(this), "Unexpected character \"%c\"", *this->it);
+		return NULL;
+	}
+}
+
+/* Parses a key and the ":" after it, the key is added to the object without a value */
+static int jsonParseKey(JsonParser *this, JsonObj *obj) {
+	if (*this->it != '"')
+		return jsonError(this, this->row, JSON_COL(this), "Expected a key (string)");
+
+	/* Interned keys are unescaped into the scratch buffer and only copied the first time */
+	bool intern  = this->arena != NULL && this->arena->keys != NULL;
+	int  strings = this->strings;
+	if (intern && strings == JSON_STRINGS_ALLOC)
+		this->strings = JSON_STRINGS_SCRATCH;
+
+	size_t col = JSON_COL(this), keyLength;
+	char  *key = jsonEscapeString(this, &keyLength);
+	this->strings = strings;
+	if (key == NULL)
+		return -1;
+
+	unsigned hash = jsonHashKey(key);
+	if (intern)
+		key = jsonIntern(this->arena, key, keyLength, hash, strings != JSON_STRINGS_IN_SITU);
+
+	if (jsonObjFind(obj, key, hash) != JSON_NPOS) {
+		jsonError(this, this->row, col, "Duplicate key \"%s\" in object", key);
+		if (this->strings == JSON_STRINGS_ALLOC)
+			jsonFree(this->arena, key);
+		return -1;
+	}
+
+	jsonObjInsert(obj, key, hash, NULL);
+
+	if (jsonSkipWhitespacesAndComments(this) != 0)
+		return -1;
+
+	if (*this->it != ':')
+		return jsonError(this, this->row, JSON_COL(this), "Expected a \":\"");
+
+	++ this->it;
+	return 0;
+}
+
+typedef struct {
+	Json  *json;     /* Open list or object */
+	size_t row, col; /* Position of its opening bracket */
+} JsonParserLevel;
+
+/* Levels of the parser are kept on the C stack unless the input is deeply nested */
+#define JSON_PARSER_LOCAL_DEPTH 32
+
+/* Parses a value, the open lists and objects are kept on an explicit stack instead of recursing.
+   Like in the event parser, containers can end with a trailing comma */
+static Json *jsonParseAtom(JsonParser *this) {
+	JsonParserLevel local[JSON_PARSER_LOCAL_DEPTH], *stack = local;
+	size_t          depth = 0, cap = JSON_PARSER_LOCAL_DEPTH;
+	Json           *json  = NULL; /* Value that is not in a container yet */
+
+	while (true) {
+		if (jsonSkipWhitespacesAndComments(this) != 0)
+			goto fail;
+
+		char ch = *this->it;
+		if (ch == '{' || ch == '[') {
+			if (depth >= JSON_MAX_DEPTH) {
+				jsonError(this, this->row, JSON_COL(this),
+				          "Exceeded the maximum nesting depth of %d", JSON_MAX_DEPTH);
+				goto fail;
+			}
+
+			if (depth >= cap)
+				stack = (JsonParserLevel*)jsonStackGrow(stack, local, &cap, sizeof(JsonParserLevel));
+
+			JsonParserLevel *level = stack + depth ++;
+			level->json = ch == '{'? (Json*)jsonNewObj_(this->arena) : (Json*)jsonNewList_(this->arena);
+			level->row  = this->row;
+			level->col  = JSON_COL(this);
+			++ this->it;
+
+			if (jsonSkipWhitespacesAndComments(this) != 0)
+				goto fail;
+
+			if (*this->it != (ch == '{'? '}' : ']')) {
+				if (ch == '{' && jsonParseKey(this, JSON_OBJ(level->json)) != 0)
+					goto fail;
+
+				continue;
+			}
+
+			++ this->it;
+			json = stack[-- depth].json;
+		} else if ((json = jsonParseScalar(this)) == NULL)
+			goto fail;
+
+		/* Add the value to its container, then close the containers that end after it */
+		while (true) {
+			if (depth == 0) {
+				if (jsonSkipWhitespacesAndComments(this) != 0)
+					goto fail;
+
+				if (stack != local)
+					nochFree(stack);
+				return json;
+			}
+
+			JsonParserLevel *level = stack + depth - 1;
+			if (level->json->type == JSON_OBJ) {
+				JsonObj *obj = JSON_OBJ(level->json);
+				obj->buckets[obj->size - 1].value = json;
+			} else
+				jsonListPush(JSON_LIST(level->json), json);
+			json = NULL;
+
+			if (jsonSkipWhitespacesAndComments(this) != 0)
+				goto fail;
+
+			char close = level->json->type == JSON_OBJ? '}' : ']';
+			if (*this->it == ',') {
+				++ this->it;
+				if (jsonSkipWhitespacesAndComments(this) != 0)
+					goto fail;
+
+				if (*this->it != close) {
+					if (close == '}' && jsonParseKey(this, JSON_OBJ(level->json)) != 0)
+						goto fail;
+
+					break;
+				}
+			} else if (*this->it != close) {
+				jsonError(this, this->row, JSON_COL(this),
+				          "Expected a matching \"%c\" (for \"%c\" at %lu:%lu)",
+				          close, close == '}'? '{' : '[',
+				          (long unsigned)level->row, (long unsigned)level->col);
+				goto fail;
+			}
+
+			++ this->it;
+			json = stack[-- depth].json;
+		}
+	}
+
+fail:
+	/* Containers are only added to their parent once they are closed */
+	if (json != NULL)
+		jsonDestroy(json);
+	while (depth > 0)
+		jsonDestroy(stack[-- depth].json);
+
+	if (stack != local)
+		nochFree(stack);
+	return NULL;
+}
+
+static void jsonParserInit(JsonParser *this, const char *str, const char *path) {
+	memset(this, 0, sizeof(*this));
+	this->path = path;
+	this->in   = str;
+	this->it   = str;
+	this->bol  = str;
+	this->row  = 1;
+}
+
+/* Releases the parser's scratch buffer once done */
+static Json *jsonParseRoot(JsonParser *this) {
+	Json *json = jsonParseAtom(this);
+	nochFree(this->scratch);
+	this->scratch    = NULL;
+	this->scratchCap = 0;
+	if (json == NULL)
+		return NULL;
+
+	if (*this->it != '\0')
+		jsonError(this, this->row, JSON_COL(this),
+		          "Unexpected character \"%c\" after end of JSON data", *this->it);
+	else if (this->end != NULL && this->it != this->end)
+		jsonError(this, this->row, JSON_COL(this), "Unexpected NUL character in input");
+	else
+		return json;
+
+	jsonDestroy(json);
+	return NULL;
+}
+
+static Json *jsonParse(const char *str, const char *end, const char *path,
+                       JsonArena *arena, bool inSitu) {
+	JsonParser parser;
+	jsonParserInit(&parser, str, path);
+	parser.end     = end;
+	parser.arena   = arena;
+	parser.strings = inSitu? JSON_STRINGS_IN_SITU : JSON_STRINGS_ALLOC;
+	return jsonParseRoot(&parser);
+}
+
+/* Contents of a file, always followed by a NUL. mapSize is 0 when they were read into a copy */
+typedef struct {
+	char  *data;
+	size_t size, mapSize;
+} JsonFile;
+
+static int jsonReadFileCopy(JsonFile *this, const char *path) {
+	FILE *file = fopen(path, "rb");
+	if (file == NULL)
+		return nochErrorAt(NOCH_ERROR_IO, path, 0, 0, "Failed to open file");
+
+	long size = -1;
+	if (fseek(file, 0, SEEK_END) == 0)
+		size = ftell(file);
+
+	if (size < 0) {
+		fclose(file);
+		return nochErrorAt(NOCH_ERROR_IO, path, 0, 0, "Failed to read file");
+	} else if (size == 0) {
+		fclose(file);
+		return nochErrorAt(NOCH_ERROR_IO, path, 0, 0, "File is empty");
+	}
+
+	rewind(file);
+
+	this->size    = (size_t)size;
+	this->mapSize = 0;
+	this->data    = (char*)jsonAlloc(NULL, this->size + 1);
+
+	if (fread(this->data, this->size, 1, file) != 1) {
+		nochFree(this->data);
+		fclose(file);
+		return nochErrorAt(NOCH_ERROR_IO, path, 0, 0, "Failed to read file");
+	}
+
+	this->data[this->size] = '\0';
+	fclose(file);
+	return 0;
+}
+
+static int jsonReadFile(JsonFile *this, const char *path) {
+#ifdef JSON_MMAP
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return nochErrorAt(NOCH_ERROR_IO, path, 0, 0, "Failed to open file");
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+		/* Pipes and devices can not be mapped */
+		close(fd);
+		return jsonReadFileCopy(this, path);
+	} else if (info.st_size == 0) {
+		close(fd);
+		return nochErrorAt(NOCH_ERROR_IO, path, 0, 0, "File is empty");
+	}
+
+	/* The rest of the last page reads as zeros, which terminates the input for the parser. Files
+	   that end exactly at a page boundary have no such padding, so they are read instead */
+	long pageSize = sysconf(_SC_PAGESIZE);
+	if (pageSize <= 0 || (size_t)info.st_size % (size_t)pageSize == 0) {
+		close(fd);
+		return jsonReadFileCopy(this, path);
+	}
+
+	void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return jsonReadFileCopy(this, path);
+
+	this->data    = (char*)data;
+	this->size    = (size_t)info.st_size;
+	this->mapSize = this->size;
+	return 0;
+#else
+	return jsonReadFileCopy(this, path);
+#endif
+}
+
+static void jsonFileFree(JsonFile *this) {
+#ifdef JSON_MMAP
+	if (this->mapSize > 0) {
+		munmap(this->data, this->mapSize);
+		return;
+	}
+#endif
+
+	nochFree(this->data);
+}
+
+NOCH_DEF Json *jsonFromFile(const char *path) {
+	nochAssert(path != NULL);
+
+	JsonFile file;
+	if (jsonReadFile(&file, path) != 0)
+		return NULL;
+
+	Json *json = jsonParse(file.data, file.data + file.size, path, NULL, false);
+	jsonFileFree(&file);
+	return json;
+}
+
+NOCH_DEF Json *jsonFromString(const char *str) {
+	nochAssert(str != NULL);
+	return jsonParse(str, NULL, NULL, NULL, false);
+}
+
+static JsonDoc *jsonDocNewSized(size_t cap) {
+	/* A big guess is not reserved up front, the arena grows from the largest block instead */
+	if (cap < JSON_ARENA_BLOCK_SIZE)
+		cap = JSON_ARENA_BLOCK_SIZE;
+	else if (cap > JSON_ARENA_BLOCK_MAX)
+		cap = JSON_ARENA_BLOCK_MAX;
+
+	/* The document itself lives in the first block of its own arena */
+	JsonArena arena = {0};
+	jsonArenaNewBlock(&arena, cap);
+
+	JsonDoc *this = (JsonDoc*)jsonArenaAlloc(&arena, sizeof(JsonDoc));
+	this->arena = arena;
+	this->root  = jsonNull();
+#ifdef JSON_INTERN
+	jsonKeysInit(&this->arena);
+#endif
+	return this;
+}
+
+static JsonDoc *jsonDocParse(const char *str, size_t size, const char *path, bool inSitu) {
+	/* Guess the final size of the document from the input size, so a small one usually fits a single
+	   block */
+	JsonDoc *this = jsonDocNewSized(inSitu? size : size * 2);
+
+	this->root = jsonParse(str, str + size, path, &this->arena, inSitu);
+	if (this->root == NULL) {
+		jsonDocDestroy(this);
+		return NULL;
+	}
+
+	return this;
+}
+
+NOCH_DEF JsonDoc *jsonDocNew(void) {
+	return jsonDocNewSized(JSON_ARENA_BLOCK_SIZE);
+}
+
+NOCH_DEF JsonDoc *jsonDocFromFile(const char *path) {
+	nochAssert(path != NULL);
+
+	JsonFile file;
+	if (jsonReadFile(&file, path) != 0)
+		return NULL;
+
+	JsonDoc *this = jsonDocParse(file.data, file.size, path, false);
+	jsonFileFree(&file);
+	return this;
+}
+
+NOCH_DEF JsonDoc *jsonDocFromString(const char *str) {
+	nochAssert(str != NULL);
+	return jsonDocParse(str, strlen(str), NULL, false);
+}
+
+NOCH_DEF JsonDoc *jsonDocFromStringInSitu(char *str) {
+	nochAssert(str != NULL);
+	return jsonDocParse(str, strlen(str), NULL, true);
+}
+
+NOCH_DEF void jsonDocDestroy(JsonDoc *this) {
+	nochAssert(this != NULL);
+
+	JsonArena arena = this->arena;
+	jsonArenaFree(&arena);
+}
+
+NOCH_DEF const char *jsonDocKey(JsonDoc *this, const char *key) {
+	nochAssert(this != NULL && key != NULL);
+
+	if (this->arena.keys == NULL)
+		return NULL;
+
+	JsonKey *slot = jsonKeysFind(this->arena.keys, key, strlen(key), jsonHashKey(key));
+	return slot->key;
+}
+
+NOCH_DEF JsonString *jsonDocNewString(JsonDoc *this, const char *value) {
+	nochAssert(this != NULL && value != NULL);
+	return jsonNewStringCopy_(&this->arena, value, strlen(value));
+}
+
+NOCH_DEF JsonFloat *jsonDocNewFloat(JsonDoc *this, double value) {
+	nochAssert(this != NULL);
+	return jsonNewFloat_(&this->arena, value);
+}
+
+NOCH_DEF JsonInt *jsonDocNewInt(JsonDoc *this, int64_t value) {
+	nochAssert(this != NULL);
+	return jsonNewInt_(&this->arena, value);
+}
+
+NOCH_DEF JsonBool *jsonDocNewBool(JsonDoc *this, bool value) {
+	nochAssert(this != NULL);
+	return jsonNewBool_(&this->arena, value);
+}
+
+NOCH_DEF JsonList *jsonDocNewList(JsonDoc *this) {
+	nochAssert(this != NULL);
+	return jsonNewList_(&this->arena);
+}
+
+NOCH_DEF JsonObj *jsonDocNewObj(JsonDoc *this) {
+	nochAssert(this != NULL);
+	return jsonNewObj_(&this->arena);
+}
+
+/* Skips a value by matching brackets, only strings and comments inside of it are lexed */
+static int jsonLazySkip(JsonParser *this) {
+	size_t row = this->row, col = JSON_COL(this), depth = 0;
+
+	if (*this->it != '{' && *this->it != '[' && *this->it != '"') {
+		while (*this->it != '\0' && !isspace(*this->it) && strchr(",:]}/", *this->it) == NULL)
+			++ this->it;
+
+		return 0;
+	}
+
+	do {
+		switch (*this->it) {
+		case '\0': return jsonError(this, row, col, "Expected a matching bracket");
+
+		case '"': {
+			bool hasEscapes;
+			if (jsonSkipString(this, &hasEscapes) != 0)
+				return -1;
+		} break;
+
+		case '{': case '[':
+			++ depth;
+			++ this->it;
+			break;
+
+		case '}': case ']':
+			-- depth;
+			++ this->it;
+			break;
+
+		case '/':
+			if (this->it[1] != '*')
+				return jsonError(this, this->row, JSON_COL(this), "Unexpected character \"/\"");
+
+			if (jsonSkipComment(this) != 0)
+				return -1;
+			break;
+
+		case ' ': case '\t': case '\r': case '\n': jsonSkipWhitespaces(this); break;
+
+		default: ++ this->it;
+		}
+	} while (depth > 0);
+
+	return 0;
+}
+
+/* Moves the parser to the value of a key. Returns 1 if the object has no such key */
+static int jsonLazyFindKey(JsonParser *this, const char *key, size_t keyLength) {
+	if (*this->it != '{')
+		return jsonError(this, this->row, JSON_COL(this), "Expected an object");
+
+	size_t startRow = this->row, startCol = JSON_COL(this);
+	++ this->it;
+
+	while (true) {
+		if (jsonSkipWhitespacesAndComments(this) != 0)
+			return -1;
+
+		if (*this->it == '}')
+			return 1;
+		else if (*this->it != '"')
+			return jsonError(this, this->row, JSON_COL(this), "Expected a key (string)");
+
+		/* Keys without escapes are compared in place */
+		const char *start = this->it + 1;
+		bool        hasEscapes, match;
+		if (jsonSkipString(this, &hasEscapes) != 0)
+			return -1;
+
+		if (hasEscapes) {
+			size_t      length;
+			const char *unescaped;
+
+			this->it  = start - 1;
+			unescaped = jsonEscapeString(this, &length);
+			if (unescaped == NULL)
+				return -1;
+
+			match = length == keyLength && memcmp(unescaped, key, length) == 0;
+		} else
+			match = (size_t)(this->it - 1 - start) == keyLength && memcmp(start, key, keyLength) == 0;
+
+		if (jsonSkipWhitespacesAndComments(this) != 0)
+			return -1;
+
+		if (*this->it != ':')
+			return jsonError(this, this->row, JSON_COL(this), "Expected a \":\"");
+		++ this->it;
+
+		if (jsonSkipWhitespacesAndComments(this) != 0)
+			return -1;
+
+		if (match)
+			return 0;
+
+		if (jsonLazySkip(this) != 0 || jsonSkipWhitespacesAndComments(this) != 0)
+			return -1;
+
+		if (*this->it == ',')
+			++ this->it;
+		else if (*this->it != '}') {
+			jsonPosition(this, &startRow, &startCol);
+			return jsonError(this, this->row, JSON_COL(this),
+			                 "Expected a matching \"}\" (for \"{\" at %lu:%lu)",
+			                 (long unsigned)startRow, (long unsigned)startCol);
+		}
+	}
+}
+
+/* Moves the parser to an element of a list. Returns 1 if the list is shorter */
+static int jsonLazyFindIdx(JsonParser *this, size_t idx) {
+	if (*this->it != '[')
+		return jsonError(this, this->row, JSON_COL(this), "Expected a list");
+
+	size_t startRow = this->row, startCol = JSON_COL(this);
+	++ this->it;
+
+	for (size_t i = 0;; ++ i) {
+		if (jsonSkipWhitespacesAndComments(this) != 0)
+			return -1;
+
+		if (*this->it == ']')
+			return 1;
+		else if (i == idx)
+			return 0;
+
+		if (jsonLazySkip(this) != 0 || jsonSkipWhitespacesAndComments(this) != 0)
+			return -1;
+
+		if (*this->it == ',')
+			++ this->it;
+		else if (*this->it != ']') {
+			jsonPosition(this, &startRow, &startCol);
+			return jsonError(this, this->row, JSON_COL(this),
+			                 "Expected a matching \"]\" (for \"[\" at %lu:%lu)",
+			                 (long unsigned)startRow, (long unsigned)startCol);
+		}
+	}
+}
+
+static void jsonLazyParserInit(JsonParser *this, const JsonLazy *lazy) {
+	jsonParserInit(this, lazy->in, NULL);
+	this->it      = lazy->it;
+	this->bol     = lazy->it;
+	this->origin  = lazy->it;
+	this->strings = JSON_STRINGS_SCRATCH;
+}
+
+NOCH_DEF int jsonLazyFromString(const char *str, JsonLazy *root) {
+	nochAssert(str != NULL && root != NULL);
+
+	JsonParser parser;
+	jsonParserInit(&parser, str, NULL);
+	if (jsonSkipWhitespacesAndComments(&parser) != 0)
+		return -1;
+
+	if (*parser.it == '\0')
+		return jsonError(&parser, parser.row, JSON_COL(&parser), "Unexpected end of input");
+
+	root->in = str;
+	root->it = parser.it;
+	return 0;
+}
+
+NOCH_DEF int jsonLazyObjAt(const JsonLazy *this, const char *key, JsonLazy *value) {
+	nochAssert(this != NULL && key != NULL && value != NULL);
+
+	JsonParser parser;
+	jsonLazyParserInit(&parser, this);
+
+	int ret = jsonLazyFindKey(&parser, key, strlen(key));
+	nochFree(parser.scratch);
+	if (ret == 1)
+		return jsonErrorCode(&parser, NOCH_ERROR_INVALID, 1, 1, "No key \"%s\" in object", key);
+	else if (ret != 0)
+		return -1;
+
+	value->in = this->in;
+	value->it = parser.it;
+	return 0;
+}
+
+NOCH_DEF int jsonLazyListAt(const JsonLazy *this, size_t idx, JsonLazy *value) {
+	nochAssert(this != NULL && value != NULL);
+
+	JsonParser parser;
+	jsonLazyParserInit(&parser, this);
+
+	int ret = jsonLazyFindIdx(&parser, idx);
+	if (ret == 1)
+		return jsonErrorCode(&parser, NOCH_ERROR_INVALID, 1, 1, "No index %lu in list", (long unsigned)idx);
+	else if (ret != 0)
+		return -1;
+
+	value->in = this->in;
+	value->it = parser.it;
+	return 0;
+}
+
+NOCH_DEF int jsonLazyType(const JsonLazy *this) {
+	nochAssert(this != NULL);
+
+	switch (*this->it) {
+	case '{': return JSON_OBJ;
+	case '[': return JSON_LIST;
+	case '"': return JSON_STRING;
+	default:  break;
+	}
+
+	JsonParser parser;
+	jsonLazyParserInit(&parser, this);
+
+	if (isdigit(*this->it) || *this->it == '-') {
+		int64_t intValue;
+		double  floatValue;
+		return jsonLexNumber(&parser, &intValue, &floatValue);
+	} else if (isalpha(*this->it)) {
+		bool value;
+		return jsonLexId(&parser, &value);
+	}
+
+	return jsonError(&parser, 1, 1, "Unexpected character \"%c\"", *this->it);
+}
+
+NOCH_DEF char *jsonLazyString(const JsonLazy *this, size_t *length) {
+	nochAssert(this != NULL);
+
+	JsonParser parser;
+	jsonLazyParserInit(&parser, this);
+	parser.strings = JSON_STRINGS_ALLOC;
+
+	if (*this->it != '"') {
+		jsonError(&parser, 1, 1, "Expected a string");
+		return NULL;
+	}
+
+	size_t ignored;
+	return jsonEscapeString(&parser, length == NULL? &ignored : length);
+}
+
+NOCH_DEF int jsonLazyInt(const JsonLazy *this, int64_t *value) {
+	nochAssert(this != NULL && value != NULL);
+
+	JsonParser parser;
+	jsonLazyParserInit(&parser, this);
+
+	double floatValue;
+	if (!isdigit(*this->it) && *this->it != '-')
+		return jsonError(&parser, 1, 1, "Expected an integer");
+
+	switch (jsonLexNumber(&parser, value, &floatValue)) {
+	case JSON_INT:   return 0;
+	case JSON_FLOAT: return jsonError(&parser, 1, 1, "Expected an integer, got a float");
+	default:         return -1;
+	}
+}
+
+NOCH_DEF int jsonLazyFloat(const JsonLazy *this, double *value) {
+	nochAssert(this != NULL && value != NULL);
+
+	JsonParser parser;
+	jsonLazyParserInit(&parser, this);
+
+	int64_t intValue;
+	if (!isdigit(*this->it) && *this->it != '-')
+		return jsonError(&parser, 1, 1, "Expected a number");
+
+	switch (jsonLexNumber(&parser, &intValue, value)) {
+	case JSON_INT:   *value = (double)intValue; return 0;
+	case JSON_FLOAT: return 0;
+	default:         return -1;
+	}
+}
+
+NOCH_DEF int jsonLazyBool(const JsonLazy *this, bool *value) {
+	nochAssert(this != NULL && value != NULL);
+
+	JsonParser parser;
+	jsonLazyParserInit(&parser, this);
+
+	if (!isalpha(*this->it) || jsonLexId(&parser, value) != JSON_BOOL)
+		return jsonError(&parser, 1, 1, "Expected a bool");
+
+	return 0;
+}
+
+NOCH_DEF Json *jsonLazyParse(const JsonLazy *this) {
+	nochAssert(this != NULL);
+
+	JsonParser parser;
+	jsonLazyParserInit(&parser, this);
+	parser.strings = JSON_STRINGS_ALLOC;
+
+	Json *json = jsonParseAtom(&parser);
+	nochFree(parser.scratch);
+	return json;
+}
+
+enum {
+	JSON_PATCH_ADD = 0,
+	JSON_PATCH_REMOVE,
+	JSON_PATCH_REPLACE,
+	JSON_PATCH_MOVE,
+	JSON_PATCH_COPY,
+	JSON_PATCH_TEST,
+	JSON_PATCH_READ, /* Only a step of the text mode, the first half of a copy */
+};
+
+static const char *jsonPatchOps[] = {"add", "remove", "replace", "move", "copy", "test"};
+
+/* An operation of a JSON patch (RFC 6902) with its pointers compiled */
+typedef struct {
+	int       op;
+	JsonPath *path, *from; /* from is only set for move and copy */
+	Json     *value;       /* Only set for add, replace and test */
+} JsonPatchOp;
+
+static void jsonPatchOpFree(JsonPatchOp *this) {
+	if (this->path != NULL)
+		jsonPathDestroy(this->path);
+
+	if (this->from != NULL)
+		jsonPathDestroy(this->from);
+}
+
+static int jsonPatchReadPointer(JsonObj *op, const char *member, size_t i, JsonPath **path) {
+	Json **str = jsonObjAt(op, member);
+	if (str == NULL || *str == NULL || (*str)->type != JSON_STRING)
+		return nochError("Patch operation %lu: Expected a \"%s\" string", (long unsigned)i, member);
+
+	const char *pointer = JSON_STRING(*str)->data;
+	if (*pointer != '/' && *pointer != '\0')
+		return nochError("Patch operation %lu: \"%s\" is not a JSON pointer", (long unsigned)i, pointer);
+
+	*path = jsonPathCompile(pointer);
+	return *path == NULL? -1 : 0;
+}
+
+static int jsonPatchReadOp(JsonPatchOp *this, Json *json, size_t i) {
+	this->path  = NULL;
+	this->from  = NULL;
+	this->value = NULL;
+
+	if (json->type != JSON_OBJ)
+		return nochError("Patch operation %lu: Expected an object", (long unsigned)i);
+
+	JsonObj *op   = JSON_OBJ(json);
+	Json   **name = jsonObjAt(op, "op");
+	if (name == NULL || *name == NULL || (*name)->type != JSON_STRING)
+		return nochError("Patch operation %lu: Expected an \"op\" string", (long unsigned)i);
+
+	this->op = -1;
+	for (size_t j = 0; j < sizeof(jsonPatchOps) / sizeof(*jsonPatchOps); ++ j) {
+		if (strcmp(JSON_STRING(*name)->data, jsonPatchOps[j]) == 0)
+			this->op = j;
+	}
+
+	if (this->op == -1)
+		return nochError("Patch operation %lu: Unknown operation \"%s\"",
+		                 (long unsigned)i, JSON_STRING(*name)->data);
+
+	if (jsonPatchReadPointer(op, "path", i, &this->path) != 0)
+		return -1;
+
+	if (this->op == JSON_PATCH_MOVE || this->op == JSON_PATCH_COPY) {
+		if (jsonPatchReadPointer(op, "from", i, &this->from) != 0) {
+			jsonPatchOpFree(this);
+			return -1;
+		}
+
+		/* A value can not be moved into one of its own children */
+		bool prefix = this->op == JSON_PATCH_MOVE && this->from->count < this->path->count;
+		for (size_t j = 0; prefix && j < this->from->count; ++ j) {
+			if (strcmp(this->from->steps[j].key, this->path->steps[j].key) != 0)
+				prefix = false;
+		}
+
+		if (prefix) {
+			jsonPatchOpFree(this);
+			return nochError("Patch operation %lu: Can not move a value into itself", (long unsigned)i);
+		}
+	} else if (this->op != JSON_PATCH_REMOVE) {
+		Json **value = jsonObjAt(op, "value");
+		if (value == NULL || *value == NULL) {
+			jsonPatchOpFree(this);
+			return nochError("Patch operation %lu: Expected a \"value\"", (long unsigned)i);
+		}
+
+		this->value = *value;
+	}
+
+	return 0;
+}
+
+/* Returns the slot holding the value the first count steps of a pointer lead to, NULL if there is
+   no such value */
+static Json **jsonPatchSlot(Json **root, const JsonPath *path, size_t count) {
+	Json **slot = root;
+	for (size_t i = 0; i < count; ++ i) {
+		const JsonPathStep *step = path->steps + i;
+
+		if ((*slot)->type == JSON_OBJ) {
+			JsonObj *obj = JSON_OBJ(*slot);
+			size_t   idx = jsonObjFind(obj, step->key, step->hash);
+			if (idx == JSON_NPOS || obj->buckets[idx].value == NULL)
+				return NULL;
+
+			slot = &obj->buckets[idx].value;
+		} else if ((*slot)->type == JSON_LIST) {
+			JsonList *list = JSON_LIST(*slot);
+			if (step->idx >= list->size)
+				return NULL;
+
+			slot = list->buf + step->idx;
+		} else
+			return NULL;
+	}
+
+	return slot;
+}
+
+/* Takes ownership of the value on success only */
+static int jsonPatchPut(Json **root, const JsonPath *path, Json *json) {
+	if (path->count == 0) {
+		jsonDestroy(*root);
+		*root = json;
+		return 0;
+	}
+
+	const JsonPathStep *last   = path->steps + path->count - 1;
+	Json              **parent = jsonPatchSlot(root, path, path->count - 1);
+	if (parent != NULL && (*parent)->type == JSON_OBJ) {
+		jsonObjSet_(JSON_OBJ(*parent), last->key, json);
+		return 0;
+	} else if (parent != NULL && (*parent)->type == JSON_LIST) {
+		/* "-" is the index past the end of a list */
+		if (strcmp(last->key, "-") == 0) {
+			jsonListPush_(JSON_LIST(*parent), json);
+			return 0;
+		} else if (jsonListInsert_(JSON_LIST(*parent), last->idx, json) != NULL)
+			return 0;
+	}
+
+	return -1;
+}
+
+/* Takes ownership of the value, which is destroyed on failure */
+static int jsonPatchAdd(Json **root, const JsonPath *path, Json *json) {
+	if (jsonPatchPut(root, path, json) == 0)
+		return 0;
+
+	jsonDestroy(json);
+	return -1;
+}
+
+/* Detaches the value from its parent, returns NULL if there is no such value */
+static Json *jsonPatchTake(Json **root, const JsonPath *path) {
+	if (path->count == 0)
+		return NULL;
+
+	const JsonPathStep *last   = path->steps + path->count - 1;
+	Json              **parent = jsonPatchSlot(root, path, path->count - 1);
+	if (parent != NULL && (*parent)->type == JSON_OBJ) {
+		size_t idx = jsonObjFind(JSON_OBJ(*parent), last->key, last->hash);
+		if (idx != JSON_NPOS)
+			return jsonObjTake(JSON_OBJ(*parent), idx);
+	} else if (parent != NULL && (*parent)->type == JSON_LIST) {
+		if (last->idx < JSON_LIST(*parent)->size)
+			return jsonListTake(JSON_LIST(*parent), last->idx);
+	}
+
+	return NULL;
+}
+
+static int jsonPatchApply(JsonArena *arena, Json **root, const JsonPatchOp *op, size_t i) {
+	Json **slot, *json;
+	switch (op->op) {
+	case JSON_PATCH_ADD:
+		if (jsonPatchAdd(root, op->path, jsonCloneInto(arena, op->value)) == 0)
+			return 0;
+		break;
+
+	case JSON_PATCH_REMOVE:
+		json = jsonPatchTake(root, op->path);
+		if (json != NULL) {
+			jsonDestroy(json);
+			return 0;
+		}
+		break;
+
+	case JSON_PATCH_REPLACE:
+		slot = jsonPatchSlot(root, op->path, op->path->count);
+		if (slot != NULL) {
+			jsonDestroy(*slot);
+			*slot = jsonCloneInto(arena, op->value);
+			return 0;
+		}
+		break;
+
+	case JSON_PATCH_MOVE:
+		json = jsonPatchTake(root, op->from);
+		if (json == NULL)
+			break;
+		else if (jsonPatchPut(root, op->path, json) == 0)
+			return 0;
+
+		/* The path is checked only once the value is taken, so a failed move puts it back (a
+		   member goes to the end of its object) */
+		if (jsonPatchPut(root, op->from, json) != 0)
+			nochAssert(0 && "Could not put a moved value back");
+		break;
+
+	case JSON_PATCH_COPY:
+		slot = jsonPatchSlot(root, op->from, op->from->count);
+		if (slot != NULL && jsonPatchAdd(root, op->path, jsonCloneInto(arena, *slot)) == 0)
+			return 0;
+		break;
+
+	case JSON_PATCH_TEST:
+		slot = jsonPatchSlot(root, op->path, op->path->count);
+		if (slot != NULL && jsonEqualsEx(*slot, op->value, true))
+			return 0;
+
+		return nochError("Patch operation %lu: Test failed", (long unsigned)i);
+
+	default: nochAssert(0 && "Unknown patch operation");
+	}
+
+	return nochError("Patch operation %lu: No value at the path", (long unsigned)i);
+}
+
+static int jsonPatchInto(JsonArena *arena, Json **root, Json *patch) {
+	if (patch->type != JSON_LIST)
+		return nochError("Expected a list of patch operations");
+
+	JsonList *list = JSON_LIST(patch);
+	for (size_t i = 0; i < list->size; ++ i) {
+		JsonPatchOp op;
+		if (jsonPatchReadOp(&op, list->buf[i], i) != 0)
+			return -1;
+
+		int ret = jsonPatchApply(arena, root, &op, i);
+		jsonPatchOpFree(&op);
+		if (ret != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+NOCH_DEF int jsonPatch_(Json **root, Json *patch) {
+	nochAssert(root != NULL && *root != NULL && patch != NULL);
+	return jsonPatchInto(NULL, root, patch);
+}
+
+NOCH_DEF int jsonDocPatch_(JsonDoc *this, Json *patch) {
+	nochAssert(this != NULL && patch != NULL);
+	return jsonPatchInto(&this->arena, &this->root, patch);
+}
+
+/* Merges the objects of the patch into those of the target on an explicit stack of
+   (patch, target) pairs */
+static void jsonMergePatchInto(JsonArena *arena, Json **root, Json *patch) {
+	if (patch->type != JSON_OBJ) {
+		jsonDestroy(*root);
+		*root = jsonCloneInto(arena, patch);
+		return;
+	} else if ((*root)->type != JSON_OBJ) {
+		jsonDestroy(*root);
+		*root = (Json*)jsonNewObj_(arena);
+	}
+
+	JsonPair local[JSON_PAIRS_LOCAL_DEPTH], *stack = local;
+	size_t   depth = 0, cap = JSON_PAIRS_LOCAL_DEPTH;
+
+	stack[depth].a = patch;
+	stack[depth].b = *root;
+	++ depth;
+
+	while (depth > 0) {
+		JsonPair pair   = stack[-- depth];
+		JsonObj *obj    = JSON_OBJ(pair.a);
+		JsonObj *target = JSON_OBJ(pair.b);
+
+		for (size_t i = 0; i < obj->size; ++ i) {
+			JsonObjBucket *bucket = obj->buckets + i;
+			if (bucket->key == NULL || bucket->value == NULL)
+				continue;
+
+			/* Null removes a key, objects are merged and anything else replaces the value */
+			Json *value = bucket->value;
+			if (value->type == JSON_NULL) {
+				jsonObjRemove(target, bucket->key);
+				continue;
+			} else if (value->type != JSON_OBJ) {
+				jsonObjSet_(target, bucket->key, jsonCloneInto(arena, value));
+				continue;
+			}
+
+			size_t idx  = jsonObjFind(target, bucket->key, bucket->hash);
+			Json **slot = idx == JSON_NPOS? NULL : &target->buckets[idx].value;
+			if (slot == NULL || *slot == NULL || (*slot)->type != JSON_OBJ)
+				slot = jsonObjSet_(target, bucket->key, (Json*)jsonNewObj_(arena));
+
+			if (depth >= cap)
+				stack = (JsonPair*)jsonStackGrow(stack, local, &cap, sizeof(JsonPair));
+
+			stack[depth].a = value;
+			stack[depth].b = *slot;
+			++ depth;
+		}
+	}
+
+	if (stack != local)
+		nochFree(stack);
+}
+
+NOCH_DEF void jsonMergePatch_(Json **root, Json *patch) {
+	nochAssert(root != NULL && *root != NULL && patch != NULL);
+	jsonMergePatchInto(NULL, root, patch);
+}
+
+NOCH_DEF void jsonDocMergePatch_(JsonDoc *this, Json *patch) {
+	nochAssert(this != NULL && patch != NULL);
+	jsonMergePatchInto(&this->arena, &this->root, patch);
+}
+
+/* Byte offsets of a member of a container in the text being patched. If the member is missing,
+   member is the offset of the closing bracket and prevEnd the end of the last value */
+typedef struct {
+	size_t open;       /* Opening bracket of the container */
+	size_t member;     /* Start of the member, which is its key in objects */
+	size_t value, end; /* Range of the value */
+	size_t next;       /* Start of the next member (or the closing bracket), past the comma */
+	size_t prevEnd;    /* End of the value before, JSON_NPOS if the member is the first one */
+	size_t count;      /* Members before this one */
+	bool   found;
+} JsonPatchSpan;
+
+/* The text mode works on steps with a single pointer each: a move removes the value and then adds
+   it, a copy reads it and then adds it */
+typedef struct {
+	int             op;
+	const JsonPath *path;
+	Json           *value; /* NULL if the added text is carried over in data */
+	char           *data;
+	size_t          size;
+	bool            carry; /* The text of the value goes to the next step */
+	size_t          index; /* Of the operation in the patch */
+
+	/* Where the pointer leads: 0 to a value, 1 to a missing last member (span then tells where it
+	   would go), 2 nowhere because the path breaks off earlier. -1 until it is located */
+	int           ret;
+	JsonPatchSpan span;
+} JsonPatchAction;
+
+static size_t jsonPatchSplit(const JsonPatchOp *op, size_t index, JsonPatchAction *actions) {
+	JsonPatchAction action = {0};
+	action.op    = op->op;
+	action.path  = op->path;
+	action.value = op->value;
+	action.index = index;
+
+	if (op->op != JSON_PATCH_MOVE && op->op != JSON_PATCH_COPY) {
+		actions[0] = action;
+		return 1;
+	}
+
+	actions[0]       = action;
+	actions[0].op    = op->op == JSON_PATCH_MOVE? JSON_PATCH_REMOVE : JSON_PATCH_READ;
+	actions[0].path  = op->from;
+	actions[0].carry = true;
+
+	actions[1]    = action;
+	actions[1].op = JSON_PATCH_ADD;
+	return 2;
+}
+
+/* Whether the first count steps of a are the first steps of b */
+static bool jsonPatchIsPrefix(const JsonPath *a, size_t count, const JsonPath *b) {
+	if (count > b->count)
+		return false;
+
+	for (size_t i = 0; i < count; ++ i) {
+		if (strcmp(a->steps[i].key, b->steps[i].key) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+static bool jsonPatchIsAppend(const JsonPatchAction *this) {
+	return this->op == JSON_PATCH_ADD && this->path->count > 0 &&
+	       strcmp(this->path->steps[this->path->count - 1].key, "-") == 0;
+}
+
+/* Whether a step has to see the text an earlier one writes. Only the pointers are compared, so
+   any step that could be an index of a list counts as one */
+static bool jsonPatchDepends(const JsonPatchAction *this, const JsonPatchAction *prev) {
+	if (prev->op == JSON_PATCH_READ || prev->op == JSON_PATCH_TEST)
+		return false;
+
+	const JsonPath *a = prev->path, *b = this->path;
+	if (jsonPatchIsAppend(this) && jsonPatchIsAppend(prev) && a->count == b->count &&
+	    jsonPatchIsPrefix(a, a->count - 1, b))
+		return false;
+	else if (jsonPatchIsPrefix(a, a->count, b) || jsonPatchIsPrefix(b, b->count, a))
+		return true;
+	else if (prev->op == JSON_PATCH_REPLACE)
+		return false;
+
+	/* Adding or removing an item moves the items after it */
+	const char *key  = a->steps[a->count - 1].key;
+	bool        list = *key != '\0';
+	if (strcmp(key, "-") != 0) {
+		for (; *key != '\0' && list; ++ key)
+			list = isdigit(*key);
+	}
+
+	return list && jsonPatchIsPrefix(a, a->count - 1, b);
+}
+
+static int jsonPatchKeyCompare(const char *stepKey, const char *key, size_t length) {
+	size_t stepLength = strlen(stepKey);
+	int    ret        = memcmp(stepKey, key, stepLength < length? stepLength : length);
+	if (ret != 0)
+		return ret;
+
+	return stepLength < length? -1 : stepLength > length;
+}
+
+/* Orders steps by their pointers, so the ones that go through the same member are next to each
+   other at every depth, those that end at it first */
+static int jsonPatchActionCompare(const void *a, const void *b) {
+	const JsonPath *pathA = (*(const JsonPatchAction**)a)->path;
+	const JsonPath *pathB = (*(const JsonPatchAction**)b)->path;
+
+	for (size_t i = 0; i < pathA->count && i < pathB->count; ++ i) {
+		int ret = strcmp(pathA->steps[i].key, pathB->steps[i].key);
+		if (ret != 0)
+			return ret;
+	}
+
+	return pathA->count < pathB->count? -1 : pathA->count > pathB->count;
+}
+
+typedef struct {
+	JsonParser parser;
+	size_t     unresolved;
+} JsonPatchLocator;
+
+static void jsonPatchResolve(JsonPatchLocator *this, JsonPatchAction *action, int ret) {
+	action->ret = ret;
+	-- this->unresolved;
+}
+
+/* Locates the steps, which share their first depth steps and are sorted, in the value the parser
+   is at. Every member is looked at once, and the values no step goes into are skipped lazily.
+   Returns 1 as soon as all steps of the pass are located */
+static int jsonPatchLocateIn(JsonPatchLocator *this, JsonPatchAction **items, size_t count,
+                             size_t depth) {
+	JsonParser *parser = &this->parser;
+
+	/* Stepping into a scalar breaks the path off like a missing member does */
+	if (*parser->it != '{' && *parser->it != '[') {
+		for (size_t i = 0; i < count; ++ i)
+			jsonPatchResolve(this, items[i], 2);
+
+		return this->unresolved == 0? 1 : jsonLazySkip(parser);
+	}
+
+	if (depth >= JSON_MAX_DEPTH)
+		return jsonError(parser, parser->row, JSON_COL(parser),
+		                 "Exceeded the maximum nesting depth of %d", JSON_MAX_DEPTH);
+
+	char   close    = *parser->it == '{'? '}' : ']';
+	size_t startRow = parser->row, startCol = JSON_COL(parser);
+	size_t open     = parser->it - parser->in, prevEnd = JSON_NPOS, members;
+	++ parser->it;
+
+	for (members = 0;; ++ members) {
+		if (jsonSkipWhitespacesAndComments(parser) != 0)
+			return -1;
+
+		size_t member = parser->it - parser->in;
+		if (*parser->it == close)
+			break;
+
+		/* List items are named by their index */
+		const char *key;
+		size_t      length;
+		char        idx[32];
+		if (close == '}') {
+			if (*parser->it != '"')
+				return jsonError(parser, parser->row, JSON_COL(parser), "Expected a key (string)");
+
+			key = jsonEscapeString(parser, &length);
+			if (key == NULL || jsonSkipWhitespacesAndComments(parser) != 0)
+				return -1;
+
+			if (*parser->it != ':')
+				return jsonError(parser, parser->row, JSON_COL(parser), "Expected a \":\"");
+			++ parser->it;
+
+			if (jsonSkipWhitespacesAndComments(parser) != 0)
+				return -1;
+		} else {
+			length = sprintf(idx, "%lu", (long unsigned)members);
+			key    = idx;
+		}
+
+		/* The steps of this member, a repeated key is ignored like jsonObjFind does */
+		size_t low = 0, high = count;
+		while (low < high) {
+			size_t mid = low + (high - low) / 2;
+			if (jsonPatchKeyCompare(items[mid]->path->steps[depth].key, key, length) < 0)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+
+		size_t deeper = low;
+		while (high < count && jsonPatchKeyCompare(items[high]->path->steps[depth].key, key,
+		                                           length) == 0)
+			++ high;
+
+		if (low < high && items[low]->ret != -1)
+			low = deeper = high;
+
+		while (deeper < high && items[deeper]->path->count == depth + 1)
+			++ deeper;
+
+		size_t value = parser->it - parser->in;
+		int    ret   = deeper < high? jsonPatchLocateIn(this, items + deeper, high - deeper, depth + 1) :
+		                              jsonLazySkip(parser);
+		if (ret != 0)
+			return ret;
+
+		size_t end = parser->it - parser->in;
+		if (jsonSkipWhitespacesAndComments(parser) != 0)
+			return -1;
+
+		if (*parser->it == ',') {
+			++ parser->it;
+			if (jsonSkipWhitespacesAndComments(parser) != 0)
+				return -1;
+		} else if (*parser->it != close) {
+			jsonPosition(parser, &startRow, &startCol);
+			return jsonError(parser, parser->row, JSON_COL(parser),
+			                 "Expected a matching \"%c\" (for \"%c\" at %lu:%lu)", close,
+			                 parser->in[open], (long unsigned)startRow, (long unsigned)startCol);
+		}
+
+		for (size_t i = low; i < deeper; ++ i) {
+			JsonPatchSpan *span = &items[i]->span;
+			span->open    = open;
+			span->member  = member;
+			span->value   = value;
+			span->end     = end;
+			span->next    = parser->it - parser->in;
+			span->prevEnd = prevEnd;
+			span->count   = members;
+			span->found   = true;
+			jsonPatchResolve(this, items[i], 0);
+		}
+
+		if (this->unresolved == 0)
+			return 1;
+
+		prevEnd = end;
+	}
+
+	for (size_t i = 0; i < count; ++ i) {
+		if (items[i]->ret != -1)
+			continue;
+		else if (items[i]->path->count > depth + 1) {
+			jsonPatchResolve(this, items[i], 2);
+			continue;
+		}
+
+		JsonPatchSpan *span = &items[i]->span;
+		span->open    = open;
+		span->member  = parser->it - parser->in;
+		span->prevEnd = prevEnd;
+		span->count   = members;
+		span->found   = false;
+		jsonPatchResolve(this, items[i], 1);
+	}
+
+	++ parser->it;
+	return this->unresolved == 0? 1 : 0;
+}
+
+/* Locates the pointers of all steps of a pass in one go over the text */
+static int jsonPatchLocate(const char *text, JsonPatchAction *actions, size_t count,
+                           JsonPatchAction **items) {
+	size_t itemCount = 0;
+	bool   root      = false;
+	for (size_t i = 0; i < count; ++ i) {
+		actions[i].ret = -1;
+		if (actions[i].path->count == 0)
+			root = true;
+		else
+			items[itemCount ++] = actions + i;
+	}
+
+	qsort(items, itemCount, sizeof(*items), jsonPatchActionCompare);
+
+	JsonPatchLocator this;
+	jsonParserInit(&this.parser, text, NULL);
+	this.parser.strings = JSON_STRINGS_SCRATCH;
+	this.unresolved     = count;
+
+	int ret = jsonSkipWhitespacesAndComments(&this.parser);
+	if (ret == 0) {
+		size_t value = this.parser.it - text;
+		if (itemCount > 0)
+			ret = jsonPatchLocateIn(&this, items, itemCount, 0);
+		else
+			ret = jsonLazySkip(&this.parser);
+
+		for (size_t i = 0; ret == 0 && root && i < count; ++ i) {
+			if (actions[i].path->count > 0)
+				continue;
+
+			actions[i].span.value   = value;
+			actions[i].span.end     = this.parser.it - text;
+			actions[i].span.prevEnd = JSON_NPOS;
+			actions[i].span.found   = true;
+			jsonPatchResolve(&this, actions + i, 0);
+		}
+	}
+
+	nochFree(this.parser.scratch);
+	return ret == -1? -1 : 0;
+}
+
+/* Replaces the bytes in [start, end) of the text the pass started with */
+typedef struct {
+	size_t start, end;
+	char  *data;
+	size_t size;
+	size_t      open; /* The container a member is added to or removed from, JSON_NPOS for values */
+	const char *key;  /* Of a member added to an object */
+	bool        removes;
+	size_t      seq;  /* Edits at the same offset are applied in order */
+} JsonPatchEdit;
+
+/* The edits of a pass are collected and applied at once when it ends */
+typedef struct {
+	char          *buf;
+	size_t         size;
+	bool           owned; /* Whether buf is ours or the text the patch was called with */
+	JsonPatchEdit *edits;
+	size_t         count, cap;
+} JsonPatchText;
+
+/* Whether an edit can go into the pass. Edits of the same container can only add members (with
+   different keys) or only remove them, shared is set if a member has been added to it already */
+static bool jsonPatchFits(JsonPatchText *this, size_t start, size_t end, size_t open,
+                          const char *key, bool removes, bool *shared) {
+	*shared = false;
+	for (size_t i = 0; i < this->count; ++ i) {
+		const JsonPatchEdit *edit = this->edits + i;
+		if (start < edit->end && edit->start < end)
+			return false;
+		else if ((start == end && edit->start < start && start < edit->end) ||
+		         (edit->start == edit->end && start < edit->start && edit->start < end))
+			return false;
+
+		if (open == JSON_NPOS || edit->open != open)
+			continue;
+		else if (edit->removes != removes)
+			return false;
+		else if (key != NULL && edit->key != NULL && strcmp(key, edit->key) == 0)
+			return false;
+		else if (!removes)
+			*shared = true;
+	}
+
+	return true;
+}
+
+static void jsonPatchAddEdit(JsonPatchText *this, size_t start, size_t end, char *data, size_t size,
+                             size_t open, const char *key, bool removes) {
+	if (this->count >= this->cap) {
+		size_t cap = this->cap == 0? 16 : this->cap * 2;
+		this->edits = (JsonPatchEdit*)jsonRealloc(NULL, this->edits, sizeof(JsonPatchEdit) * this->cap,
+		                                          sizeof(JsonPatchEdit) * cap);
+		this->cap   = cap;
+	}
+
+	JsonPatchEdit *edit = this->edits + this->count;
+	edit->start   = start;
+	edit->end     = end;
+	edit->data    = data;
+	edit->size    = size;
+	edit->open    = open;
+	edit->key     = key;
+	edit->removes = removes;
+	edit->seq     = this->count ++;
+}
+
+static int jsonPatchEditCompare(const void *a, const void *b) {
+	const JsonPatchEdit *editA = (const JsonPatchEdit*)a, *editB = (const JsonPatchEdit*)b;
+	if (editA->start != editB->start)
+		return editA->start < editB->start? -1 : 1;
+
+	return editA->seq < editB->seq? -1 : editA->seq > editB->seq;
+}
+
+/* Builds the text of the next pass from the unchanged ranges and the edits */
+static void jsonPatchFlush(JsonPatchText *this) {
+	if (this->count == 0)
+		return;
+
+	qsort(this->edits, this->count, sizeof(*this->edits), jsonPatchEditCompare);
+
+	size_t size = this->size;
+	for (size_t i = 0; i < this->count; ++ i)
+		size = size - (this->edits[i].end - this->edits[i].start) + this->edits[i].size;
+
+	char  *buf = (char*)jsonAlloc(NULL, size + 1), *it = buf;
+	size_t prev = 0;
+	for (size_t i = 0; i < this->count; ++ i) {
+		JsonPatchEdit *edit = this->edits + i;
+		memcpy(it, this->buf + prev, edit->start - prev);
+		it += edit->start - prev;
+		if (edit->size > 0)
+			memcpy(it, edit->data, edit->size);
+
+		it  += edit->size;
+		prev = edit->end;
+		nochFree(edit->data);
+	}
+
+	memcpy(it, this->buf + prev, this->size - prev);
+	buf[size] = '\0';
+
+	if (this->owned)
+		nochFree(this->buf);
+
+	this->buf   = buf;
+	this->size  = size;
+	this->owned = true;
+	this->count = 0;
+}
+
+static char *jsonPatchCopyValue(JsonPatchText *this, const JsonPatchSpan *span, size_t *size) {
+	*size = span->end - span->value;
+	char *data = (char*)jsonAlloc(NULL, *size + 1);
+	memcpy(data, this->buf + span->value, *size);
+	data[*size] = '\0';
+	return data;
+}
+
+/* Adds the compact text of a value, an existing value in an object is replaced */
+static int jsonPatchTextAdd(JsonPatchText *this, JsonPatchAction *action) {
+	const JsonPatchSpan *span = &action->span;
+	const JsonPathStep  *last = action->path->count == 0? NULL :
+	                            action->path->steps + action->path->count - 1;
+
+	/* Items are inserted before the one at their index, anything else goes after the last value */
+	bool   replace = last == NULL || (span->found && this->buf[span->open] == '{');
+	bool   before  = !replace && span->found;
+	size_t at      = before? span->member : span->prevEnd == JSON_NPOS? span->open + 1 : span->prevEnd;
+	if (!replace && !before && this->buf[span->open] == '[' && strcmp(last->key, "-") != 0 &&
+	    last->idx != span->count)
+		return nochError("Patch operation %lu: No value at the path", (long unsigned)action->index);
+
+	const char *key = !replace && this->buf[span->open] == '{'? last->key : NULL;
+	bool        shared;
+	if (replace && !jsonPatchFits(this, span->value, span->end, JSON_NPOS, NULL, false, &shared))
+		return 1;
+	else if (!replace && !jsonPatchFits(this, at, at, span->open, key, false, &shared))
+		return 1;
+
+	if (action->data == NULL) {
+		action->data = jsonStringifyEx_(action->value, JSON_COMPACT);
+		action->size = strlen(action->data);
+	}
+
+	if (replace) {
+		jsonPatchAddEdit(this, span->value, span->end, action->data, action->size, JSON_NPOS, NULL,
+		                 false);
+		action->data = NULL;
+		return 0;
+	}
+
+	JsonOutputStream fragment;
+	jsonOutputInit(&fragment, JSON_OUTPUT_STRING, JSON_COMPACT);
+	fragment.cap = action->size + 16;
+	fragment.buf = (char*)jsonAlloc(NULL, fragment.cap + 1);
+
+	if (before) {
+		jsonWrite(&fragment, action->data, action->size);
+		jsonWriteChar(&fragment, ',');
+	} else {
+		if (span->prevEnd != JSON_NPOS || shared)
+			jsonWriteChar(&fragment, ',');
+
+		if (key != NULL) {
+			jsonWriteString(&fragment, key, strlen(key));
+			jsonWriteChar(&fragment, ':');
+		}
+
+		jsonWrite(&fragment, action->data, action->size);
+	}
+
+	jsonPatchAddEdit(this, at, at, fragment.buf, fragment.size, span->open, key, false);
+	return 0;
+}
+
+/* Applies a located step to the pass, returns 1 if it has to wait for the next pass */
+static int jsonPatchTextStep(JsonPatchText *this, JsonPatchAction *action) {
+	const JsonPatchSpan *span = &action->span;
+	size_t               i    = action->index;
+	bool                 shared;
+
+	if (action->op == JSON_PATCH_TEST) {
+		JsonLazy lazy;
+		lazy.in = this->buf;
+		lazy.it = this->buf + span->value;
+
+		Json *json = action->ret == 0? jsonLazyParse(&lazy) : NULL;
+		if (action->ret == 0 && json == NULL)
+			return -1;
+
+		bool equals = json != NULL && jsonEqualsEx(json, action->value, true);
+		if (json != NULL)
+			jsonDestroy(json);
+
+		return equals? 0 : nochError("Patch operation %lu: Test failed", (long unsigned)i);
+	} else if (action->ret == 2 || (action->ret == 1 && action->op != JSON_PATCH_ADD) ||
+	           (action->op == JSON_PATCH_REMOVE && action->path->count == 0))
+		return nochError("Patch operation %lu: No value at the path", (long unsigned)i);
+
+	switch (action->op) {
+	case JSON_PATCH_ADD: return jsonPatchTextAdd(this, action);
+
+	/* The source text of a move or a copy is carried over as it is */
+	case JSON_PATCH_READ:
+		action[1].data = jsonPatchCopyValue(this, span, &action[1].size);
+		return 0;
+
+	case JSON_PATCH_REPLACE: {
+		if (!jsonPatchFits(this, span->value, span->end, JSON_NPOS, NULL, false, &shared))
+			return 1;
+
+		char *data = jsonStringifyEx_(action->value, JSON_COMPACT);
+		jsonPatchAddEdit(this, span->value, span->end, data, strlen(data), JSON_NPOS, NULL, false);
+		return 0;
+	}
+
+	case JSON_PATCH_REMOVE: {
+		/* The first member goes with the comma after it, any other with the comma before it */
+		size_t start = span->prevEnd == JSON_NPOS? span->member : span->prevEnd;
+		size_t end   = span->prevEnd == JSON_NPOS? span->next   : span->end;
+		if (!jsonPatchFits(this, start, end, span->open, NULL, true, &shared))
+			return 1;
+
+		if (action->carry)
+			action[1].data = jsonPatchCopyValue(this, span, &action[1].size);
+
+		jsonPatchAddEdit(this, start, end, NULL, 0, span->open, NULL, true);
+		return 0;
+	}
+
+	default: nochAssert(0 && "Unknown patch operation");
+	}
+
+	return 0;
+}
+
+NOCH_DEF char *jsonPatchText_(const char *text, Json *patch, size_t *length) {
+	nochAssert(text != NULL && patch != NULL);
+
+	if (patch->type != JSON_LIST) {
+		nochError("Expected a list of patch operations");
+		return NULL;
+	}
+
+	JsonList         *list    = JSON_LIST(patch);
+	JsonPatchOp      *ops     = (JsonPatchOp*)jsonAlloc(NULL, sizeof(JsonPatchOp) * (list->size + 1));
+	JsonPatchAction  *actions = (JsonPatchAction*)jsonAlloc(NULL, sizeof(JsonPatchAction) *
+	                                                        (list->size * 2 + 1));
+	JsonPatchAction **items   = (JsonPatchAction**)jsonAlloc(NULL, sizeof(JsonPatchAction*) *
+	                                                         (list->size * 2 + 1));
+
+	size_t opCount = 0, count = 0;
+	for (; opCount < list->size; ++ opCount) {
+		if (jsonPatchReadOp(ops + opCount, list->buf[opCount], opCount) != 0)
+			break;
+
+		count += jsonPatchSplit(ops + opCount, opCount, actions + count);
+	}
+
+	JsonPatchText this;
+	this.buf   = (char*)text;
+	this.size  = strlen(text);
+	this.owned = false;
+	this.edits = NULL;
+	this.count = 0;
+	this.cap   = 0;
+
+	/* A pass takes the following steps that do not depend on each other, locates them all in one go
+	   and then builds the new text in another. A step that still collides with an edit of the pass
+	   waits for the next one */
+	int ret = 0;
+	for (size_t first = 0; ret == 0 && first < count;) {
+		size_t last = first + 1;
+		for (bool depends = false; last < count && !depends; last += !depends) {
+			for (size_t i = first; i < last && !depends; ++ i)
+				depends = jsonPatchDepends(actions + last, actions + i);
+		}
+
+		ret = jsonPatchLocate(this.buf, actions + first, last - first, items);
+		for (; ret == 0 && first < last; ++ first) {
+			ret = jsonPatchTextStep(&this, actions + first);
+			if (ret == 1) {
+				ret = 0;
+				break;
+			}
+		}
+
+		jsonPatchFlush(&this);
+	}
+
+	/* A malformed operation is reported once the ones before it are applied, its error is still
+	   set then */
+	if (ret == 0 && opCount < list->size)
+		ret = -1;
+
+	for (size_t i = 0; i < count; ++ i)
+		nochFree(actions[i].data);
+
+	for (size_t i = 0; i < this.count; ++ i)
+		nochFree(this.edits[i].data);
+
+	for (size_t i = 0; i < opCount; ++ i)
+		jsonPatchOpFree(ops + i);
+
+	nochFree(this.edits);
+	nochFree(items);
+	nochFree(actions);
+	nochFree(ops);
+
+	if (ret != 0) {
+		if (this.owned)
+			nochFree(this.buf);
+
+		return NULL;
+	} else if (!this.owned) {
+		this.buf = (char*)jsonAlloc(NULL, this.size + 1);
+		memcpy(this.buf, text, this.size + 1);
+	}
+
+	if (length != NULL)
+		*length = this.size;
+
+	return this.buf;
+}
+
+enum {
+	JSON_CBOR_UINT = 0,
+	JSON_CBOR_NEGATIVE,
+	JSON_CBOR_BYTES,
+	JSON_CBOR_TEXT,
+	JSON_CBOR_ARRAY,
+	JSON_CBOR_MAP,
+	JSON_CBOR_TAG,
+	JSON_CBOR_SIMPLE,
+};
+
+#define JSON_CBOR_FALSE      0xF4
+#define JSON_CBOR_TRUE       0xF5
+#define JSON_CBOR_NULL       0xF6
+#define JSON_CBOR_UNDEFINED  0xF7
+#define JSON_CBOR_HALF       0xF9
+#define JSON_CBOR_SINGLE     0xFA
+#define JSON_CBOR_DOUBLE     0xFB
+#define JSON_CBOR_BREAK      0xFF
+#define JSON_CBOR_INDEFINITE 31
+
+/* Writes the initial byte of an item with its argument in the shortest form */
+static void jsonCborWriteHead(JsonOutputStream *this, int major, uint64_t value) {
+	unsigned char buf[9];
+	size_t        size;
+
+	if (value < 24) {
+		buf[0] = major << 5 | value;
+		size   = 0;
+	} else if (value <= 0xFF) {
+		buf[0] = major << 5 | 24;
+		size   = 1;
+	} else if (value <= 0xFFFF) {
+		buf[0] = major << 5 | 25;
+		size   = 2;
+	} else if (value <= 0xFFFFFFFF) {
+		buf[0] = major << 5 | 26;
+		size   = 4;
+	} else {
+		buf[0] = major << 5 | 27;
+		size   = 8;
+	}
+
+	for (size_t i = 0; i < size; ++ i)
+		buf[size - i] = value >> (i * 8) & 0xFF;
+
+	jsonWrite(this, (const char*)buf, size + 1);
+}
+
+static void jsonCborWriteFloat(JsonOutputStream *this, double value) {
+	unsigned char buf[9];
+	size_t        size;
+
+	/* Floats that survive the round trip through single precision are stored in half the space */
+	float single = (float)value;
+	if ((double)single == value) {
+		uint32_t bits;
+		memcpy(&bits, &single, sizeof(bits));
+
+		buf[0] = JSON_CBOR_SINGLE;
+		size   = 4;
+		for (size_t i = 0; i < size; ++ i)
+			buf[size - i] = bits >> (i * 8) & 0xFF;
+	} else {
+		uint64_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		buf[0] = JSON_CBOR_DOUBLE;
+		size   = 8;
+		for (size_t i = 0; i < size; ++ i)
+			buf[size - i] = bits >> (i * 8) & 0xFF;
+	}
+
+	jsonWrite(this, (const char*)buf, size + 1);
+}
+
+static void jsonCborWrite(JsonOutputStream *this, Json *json) {
+	nochAssert(json != NULL);
+
+	switch (json->type) {
+	case JSON_NULL:  jsonWriteChar(this, (char)JSON_CBOR_NULL); break;
+	case JSON_FLOAT: jsonCborWriteFloat(this, JSON_FLOAT(json)->value); break;
+	case JSON_BOOL:
+		jsonWriteChar(this, (char)(JSON_BOOL(json)->value? JSON_CBOR_TRUE : JSON_CBOR_FALSE));
+		break;
+
+	case JSON_STRING:
+		jsonCborWriteHead(this, JSON_CBOR_TEXT, JSON_STRING(json)->length);
+		jsonWrite(this, JSON_STRING(json)->data, JSON_STRING(json)->length);
+		break;
+
+	case JSON_INT: {
+		int64_t value = JSON_INT(json)->value;
+		if (value >= 0)
+			jsonCborWriteHead(this, JSON_CBOR_UINT, (uint64_t)value);
+		else
+			jsonCborWriteHead(this, JSON_CBOR_NEGATIVE, (uint64_t)-(value + 1));
+	} break;
+
+	case JSON_LIST: {
+		JsonList *list = JSON_LIST(json);
+
+		jsonCborWriteHead(this, JSON_CBOR_ARRAY, list->size);
+		for (size_t i = 0; i < list->size; ++ i)
+			jsonCborWrite(this, list->buf[i]);
+	} break;
+
+	case JSON_OBJ: {
+		JsonObj *obj   = JSON_OBJ(json);
+		size_t   count = 0;
+		FOREACH_IN_JSON_OBJ(obj, value, key, {
+			(void)value;
+			(void)key;
+			++ count;
+		});
+
+		jsonCborWriteHead(this, JSON_CBOR_MAP, count);
+		FOREACH_IN_JSON_OBJ(obj, value, key, {
+			size_t length = strlen(key);
+			jsonCborWriteHead(this, JSON_CBOR_TEXT, length);
+			jsonWrite(this, key, length);
+			jsonCborWrite(this, value);
+		});
 	} break;
 
-	case JSON_OBJ: {
-		JsonObj *obj = JSON_OBJ(json);
+	default: nochAssert(0 && "Unknown JSON type");
+	}
+}
+
+NOCH_DEF char *jsonToCbor_(Json *this, size_t *size) {
+	nochAssert(this != NULL && size != NULL);
+
+	JsonOutputStream outputStream;
+	jsonOutputInit(&outputStream, JSON_OUTPUT_STRING, JSON_COMPACT);
+	outputStream.cap = 256;
+	outputStream.buf = (char*)jsonAlloc(NULL, outputStream.cap + 1);
+
+	jsonCborWrite(&outputStream, this);
+
+	*size = outputStream.size;
+	return outputStream.buf;
+}
+
+NOCH_DEF int jsonToCborF_(Json *this, FILE *file) {
+	nochAssert(this != NULL && file != NULL);
+
+	JsonOutputStream outputStream;
+	jsonOutputInit(&outputStream, JSON_OUTPUT_FILE, JSON_COMPACT);
+	outputStream.file = file;
+
+	jsonCborWrite(&outputStream, this);
+	jsonOutputFlush(&outputStream, 0);
+	return outputStream.failed? nochErrorAt(NOCH_ERROR_IO, NULL, 0, 0, "Failed to write CBOR") : 0;
+}
+
+typedef struct {
+	unsigned char *in, *it, *end;
+	JsonArena     *arena;
+	bool           inSitu; /* Strings are moved over their heads and NUL terminated in place */
+	size_t         depth;  /* Arrays, maps and tags the decoder is in */
+} JsonCbor;
+
+static int jsonCborError(JsonCbor *this, const char *msg) {
+	return nochErrorAt(NOCH_ERROR_SYNTAX, NULL, 0, 0, "CBOR byte %lu: %s",
+	                   (long unsigned)(this->it - this->in), msg);
+}
+
+/* Reads the argument of the item, *major is set to its major type. Indefinite lengths are returned
+   as JSON_NPOS */
+static int jsonCborReadHead(JsonCbor *this, int *major, uint64_t *value) {
+	if (this->it >= this->end)
+		return jsonCborError(this, "Unexpected end of input");
+
+	*major   = *this->it >> 5;
+	int info = *this->it & 0x1F;
+	++ this->it;
+
+	size_t size;
+	if (info < 24) {
+		*value = info;
+		return 0;
+	} else if (info == JSON_CBOR_INDEFINITE) {
+		*value = JSON_NPOS;
+		return 0;
+	} else if (info > 27)
+		return jsonCborError(this, "Invalid additional information");
+
+	size = (size_t)1 << (info - 24);
+	if ((size_t)(this->end - this->it) < size)
+		return jsonCborError(this, "Unexpected end of input");
+
+	*value = 0;
+	for (size_t i = 0; i < size; ++ i)
+		*value = *value << 8 | *this->it ++;
+
+	return 0;
+}
+
+static double jsonCborHalfToDouble(uint16_t half) {
+	int    exponent = half >> 10 & 0x1F;
+	double mantissa = half & 0x3FF, value;
+
+	if (exponent == 31)
+		value = mantissa == 0? INFINITY : NAN;
+	else {
+		/* Subnormals have no implicit leading bit. Scaling by powers of two is exact */
+		if (exponent == 0)
+			exponent = 1;
+		else
+			mantissa += 1024;
+
+		value = mantissa;
+		for (exponent -= 25; exponent < 0; ++ exponent)
+			value /= 2;
+		for (; exponent > 0; -- exponent)
+			value *= 2;
+	}
+
+	return half & 0x8000? -value : value;
+}
+
+/* Returns the string data, NUL terminated and allocated unless in situ */
+static char *jsonCborReadString(JsonCbor *this, const unsigned char *head, uint64_t length) {
+	if (length == JSON_NPOS) {
+		jsonCborError(this, "Indefinite length strings are not supported");
+		return NULL;
+	} else if ((uint64_t)(this->end - this->it) < length) {
+		jsonCborError(this, "Unexpected end of input");
+		return NULL;
+	}
+
+	/* The head is at least a byte long, so moving the data over it leaves room for the NUL */
+	char *str;
+	if (this->inSitu) {
+		str = (char*)head;
+		memmove(str, this->it, length);
+	} else {
+		str = (char*)jsonAlloc(this->arena, length + 1);
+		memcpy(str, this->it, length);
+	}
+
+	str[length] = '\0';
+	this->it   += length;
+	return str;
+}
+
+/* Interned keys are hashed straight from the input and only copied the first time */
+static char *jsonCborReadKey(JsonCbor *this, const unsigned char *head, uint64_t length,
+                             unsigned *hash) {
+	bool intern = this->arena != NULL && this->arena->keys != NULL;
+	if (intern && !this->inSitu && length != JSON_NPOS && (uint64_t)(this->end - this->it) >= length &&
+	    memchr(this->it, '\0', length) == NULL) {
+		*hash = jsonHashBytes((const char*)this->it, length);
+
+		char *key = jsonIntern(this->arena, (char*)this->it, length, *hash, true);
+		this->it += length;
+		return key;
+	}
+
+	char *key = jsonCborReadString(this, head, length);
+	if (key == NULL)
+		return NULL;
+
+	*hash = jsonHashKey(key);
+	return intern? jsonIntern(this->arena, key, strlen(key), *hash, false) : key;
+}
+
+static Json *jsonCborRead(JsonCbor *this);
+
+static Json *jsonCborReadArray(JsonCbor *this, uint64_t count) {
+	JsonList *list = jsonNewList_(this->arena);
+	for (uint64_t i = 0; i < count; ++ i) {
+		if (count == JSON_NPOS && this->it < this->end && *this->it == JSON_CBOR_BREAK) {
+			++ this->it;
+			break;
+		}
+
+		Json *json = jsonCborRead(this);
+		if (json == NULL) {
+			jsonDestroy(list);
+			return NULL;
+		}
+
+		jsonListPush(list, json);
+	}
+
+	return (Json*)list;
+}
+
+static Json *jsonCborReadMap(JsonCbor *this, uint64_t count) {
+	JsonObj *obj = jsonNewObj_(this->arena);
+	for (uint64_t i = 0; i < count; ++ i) {
+		if (count == JSON_NPOS && this->it < this->end && *this->it == JSON_CBOR_BREAK) {
+			++ this->it;
+			break;
+		}
+
+		unsigned char *head = this->it;
+		uint64_t       length;
+		int            major;
+		if (jsonCborReadHead(this, &major, &length) != 0)
+			goto fail;
+
+		if (major != JSON_CBOR_TEXT) {
+			this->it = head;
+			jsonCborError(this, "Expected a text string key");
+			goto fail;
+		}
+
+		unsigned hash;
+		char    *key = jsonCborReadKey(this, head, length, &hash);
+		if (key == NULL)
+			goto fail;
+
+		if (jsonObjFind(obj, key, hash) != JSON_NPOS) {
+			this->it = head;
+			jsonCborError(this, "Duplicate key in map");
+			if (!this->inSitu)
+				jsonFree(this->arena, key);
+			goto fail;
+		}
+
+		Json **ref  = jsonObjInsert(obj, key, hash, NULL);
+		Json  *json = jsonCborRead(this);
+		if (json == NULL)
+			goto fail;
 
-		++ indentSize;
-		jsonOutput(this, "{");
-		if (obj->size > 0)
-			jsonOutput(this, "\n");
+		*ref = json;
+	}
 
-		for (size_t i = 0; i < obj->size; ++ i) {
-			jsonIndent(this, indentSize);
-			jsonOutputFmt(this, "\"%s\": ", obj->buckets[i].key);
-			jsonOutputJson(this, obj->buckets[i].value, indentSize, i + 1 < obj->size);
+	return (Json*)obj;
+
+fail:
+	jsonDestroy(obj);
+	return NULL;
+}
+
+static Json *jsonCborRead(JsonCbor *this) {
+	unsigned char *head = this->it;
+	uint64_t       value;
+	int            major;
+	if (jsonCborReadHead(this, &major, &value) != 0)
+		return NULL;
+
+	switch (major) {
+	case JSON_CBOR_UINT:
+		if (value > (uint64_t)INT64_MAX)
+			return (Json*)jsonNewFloat_(this->arena, (double)value);
+
+		return (Json*)jsonNewInt_(this->arena, (int64_t)value);
+
+	case JSON_CBOR_NEGATIVE:
+		if (value > (uint64_t)INT64_MAX)
+			return (Json*)jsonNewFloat_(this->arena, -1.0 - (double)value);
+
+		return (Json*)jsonNewInt_(this->arena, -(int64_t)value - 1);
+
+	case JSON_CBOR_BYTES: case JSON_CBOR_TEXT: {
+		if (!this->inSitu && value != JSON_NPOS && (uint64_t)(this->end - this->it) >= value) {
+			this->it += value;
+			return (Json*)jsonNewStringCopy_(this->arena, (const char*)this->it - value, value);
 		}
-		jsonIndent(this, -- indentSize);
-		jsonOutput(this, "}");
-	} break;
 
-	default: nochAssert(0 && "Unknown JSON type");
+		char *str = jsonCborReadString(this, head, value);
+		if (str == NULL)
+			return NULL;
+
+		return (Json*)jsonNewString_(this->arena, str, value);
+	}
+
+	case JSON_CBOR_ARRAY: case JSON_CBOR_MAP: case JSON_CBOR_TAG: {
+		if (this->depth >= JSON_MAX_DEPTH) {
+			this->it = head;
+			jsonCborError(this, "Exceeded the maximum nesting depth");
+			return NULL;
+		}
+
+		++ this->depth;
+		Json *json;
+		if (major == JSON_CBOR_ARRAY)
+			json = jsonCborReadArray(this, value);
+		else if (major == JSON_CBOR_MAP)
+			json = jsonCborReadMap(this, value);
+		else
+			json = jsonCborRead(this); /* Tags only annotate the item after them */
+
+		-- this->depth;
+		return json;
 	}
 
-	if (comma)
-		jsonOutput(this, ",");
+	default: break;
+	}
+
+	switch (*head) {
+	case JSON_CBOR_FALSE: return (Json*)jsonNewBool_(this->arena, false);
+	case JSON_CBOR_TRUE:  return (Json*)jsonNewBool_(this->arena, true);
+
+	case JSON_CBOR_NULL: case JSON_CBOR_UNDEFINED: return jsonNull();
+
+	case JSON_CBOR_HALF:
+		return (Json*)jsonNewFloat_(this->arena, jsonCborHalfToDouble((uint16_t)value));
+
+	case JSON_CBOR_SINGLE: {
+		uint32_t bits = (uint32_t)value;
+		float    single;
+		memcpy(&single, &bits, sizeof(single));
+		return (Json*)jsonNewFloat_(this->arena, single);
+	}
+
+	case JSON_CBOR_DOUBLE: {
+		double number;
+		memcpy(&number, &value, sizeof(number));
+		return (Json*)jsonNewFloat_(this->arena, number);
+	}
 
-	jsonOutput(this, "\n");
+	default:
+		this->it = head;
+		jsonCborError(this, "Unsupported simple value");
+		return NULL;
+	}
 }
 
-NOCH_DEF void jsonPrintF_(Json *this, FILE *file) {
-	nochAssert(this != NULL && file != NULL);
+static Json *jsonCborReadRoot(JsonCbor *this) {
+	Json *json = jsonCborRead(this);
+	if (json != NULL && this->it != this->end) {
+		jsonCborError(this, "Unexpected data after the end of the item");
+		jsonDestroy(json);
+		return NULL;
+	}
 
-	JsonOutputStream outputStream = {0};
-	outputStream.file = file;
+	return json;
+}
 
-	jsonOutputJson(&outputStream, this, 0, false);
+static void jsonCborInit(JsonCbor *this, void *buf, size_t size, JsonArena *arena, bool inSitu) {
+	this->in     = (unsigned char*)buf;
+	this->it     = this->in;
+	this->end    = this->in + size;
+	this->arena  = arena;
+	this->inSitu = inSitu;
+	this->depth  = 0;
 }
 
-NOCH_DEF char *jsonStringify_(Json *this) {
-	nochAssert(this != NULL);
+NOCH_DEF Json *jsonFromCbor(const void *buf, size_t size) {
+	nochAssert(buf != NULL);
 
-	JsonOutputStream outputStream = {0};
-	outputStream.cap = 256;
-	outputStream.buf = (char*)nochAlloc(outputStream.cap);
-	if (outputStream.buf == NULL)
-		NOCH_OUT_OF_MEM();
+	JsonCbor cbor;
+	jsonCborInit(&cbor, (void*)buf, size, NULL, false);
+	return jsonCborReadRoot(&cbor);
+}
 
-	jsonOutputJson(&outputStream, this, 0, false);
-	return outputStream.buf;
+static JsonDoc *jsonDocFromCbor_(void *buf, size_t size, bool inSitu) {
+	JsonDoc *this = jsonDocNewSized(inSitu? size : size * 2);
+
+	JsonCbor cbor;
+	jsonCborInit(&cbor, buf, size, &this->arena, inSitu);
+
+	this->root = jsonCborReadRoot(&cbor);
+	if (this->root == NULL) {
+		jsonDocDestroy(this);
+		return NULL;
+	}
+
+	return this;
 }
 
-typedef struct {
-	const char *in, *it, *bol; /* input, iterator, beginning of line */
-	size_t      row;
-	const char *path;
-} JsonParser;
+NOCH_DEF JsonDoc *jsonDocFromCbor(const void *buf, size_t size) {
+	nochAssert(buf != NULL);
+	return jsonDocFromCbor_((void*)buf, size, false);
+}
 
-#define JSON_COL(THIS) ((THIS)->it - (THIS)->bol + 1)
+NOCH_DEF JsonDoc *jsonDocFromCborInSitu(void *buf, size_t size) {
+	nochAssert(buf != NULL);
+	return jsonDocFromCbor_(buf, size, true);
+}
 
-static int jsonError(JsonParser *this, size_t row, size_t col, const char *fmt, ...) {
-	char    str[256];
-	va_list args;
-	va_start(args, fmt);
-	vsnprintf(str, sizeof(str), fmt, args);
-	va_end(args);
+static const JsonField *jsonStructFind(const JsonField *fields, const char *key) {
+	for (const JsonField *field = fields; field->name != NULL; ++ field) {
+		if (strcmp(field->name, key) == 0)
+			return field;
+	}
 
-	if (this->path == NULL)
-		return nochError("%lu:%lu: %s", (long unsigned)row, (long unsigned)col, str);
-	else
-		return nochError("%s:%lu:%lu: %s", this->path, (long unsigned)row, (long unsigned)col, str);
+	return NULL;
 }
 
-/* Not standard!!!! but very useful */
-static int jsonSkipComment(JsonParser *this) {
-	nochAssert(*this->it == '/' && this->it[1] == '*');
+/* Frees what was decoded into the member of the field in the struct at base */
+static void jsonStructFreeValue(const JsonField *field, char *base) {
+	char *member = base + field->offset;
+
+	switch (field->type) {
+	case JSON_FIELD_STRING:
+		nochFree(*(char**)member);
+		*(char**)member = NULL;
+		break;
+
+	case JSON_FIELD_STRUCT: jsonStructFree(field->fields, member); break;
+
+	case JSON_FIELD_LIST: {
+		char  **items = (char**)member;
+		size_t *count = (size_t*)(base + field->countOffset);
+		for (size_t i = 0; i < *count; ++ i)
+			jsonStructFreeValue(field->fields, *items + i * field->fields->size);
+
+		nochFree(*items);
+		*items = NULL;
+		*count = 0;
+	} break;
+
+	default: break;
+	}
+}
+
+NOCH_DEF void jsonStructFree(const JsonField *fields, void *this) {
+	nochAssert(fields != NULL && this != NULL);
+
+	for (const JsonField *field = fields; field->name != NULL; ++ field)
+		jsonStructFreeValue(field, (char*)this);
+}
+
+static int jsonStructReadValue(JsonParser *this, const JsonField *field, char *base);
+static int jsonStructReadObj(JsonParser *this, const JsonField *fields, char *base);
+
+static int jsonStructReadList(JsonParser *this, const JsonField *field, char *base) {
+	const JsonField *item  = field->fields;
+	char           **items = (char**)(base + field->offset);
+	size_t          *count = (size_t*)(base + field->countOffset);
+
+	if (*this->it != '[')
+		return jsonError(this, this->row, JSON_COL(this), "Expected a list for \"%s\"", field->name);
+
+	size_t startRow = this->row, startCol = JSON_COL(this);
+	++ this->it;
+
+	/* The list replaces whatever was decoded for the member before */
+	jsonStructFreeValue(field, base);
+
+	size_t cap = 0;
+	if (jsonSkipWhitespacesAndComments(this) != 0)
+		return -1;
+
+	while (*this->it != ']') {
+		if (*count >= cap) {
+			cap    = cap == 0? 8 : cap * 2;
+			*items = (char*)jsonRealloc(NULL, *items, *count * item->size, cap * item->size);
+		}
+
+		char *at = *items + *count * item->size;
+		memset(at, 0, item->size);
+		++ *count;
+
+		if (jsonStructReadValue(this, item, at) != 0)
+			return -1;
+
+		if (*this->it == ',') {
+			++ this->it;
+			if (jsonSkipWhitespacesAndComments(this) != 0)
+				return -1;
+		} else if (*this->it != ']')
+			return jsonError(this, this->row, JSON_COL(this),
+			                 "Expected a matching \"]\" (for \"[\" at %lu:%lu)",
+			                 (long unsigned)startRow, (long unsigned)startCol);
+	}
+	++ this->it;
+
+	return 0;
+}
+
+/* Decodes a value into the member of the field in the struct at base */
+static int jsonStructReadValue(JsonParser *this, const JsonField *field, char *base) {
+	const char *name   = field->name == NULL? "item" : field->name;
+	char       *member = base + field->offset;
+
+	if (jsonSkipWhitespacesAndComments(this) != 0)
+		return -1;
 
 	size_t row = this->row, col = JSON_COL(this);
+	int    ret = 0;
+
+	/* Null leaves the member as it is, except for strings which become NULL */
+	if (strncmp(this->it, "null", 4) == 0 && !isalnum(this->it[4])) {
+		this->it += 4;
+		if (field->type == JSON_FIELD_STRING) {
+			nochFree(*(char**)member);
+			*(char**)member = NULL;
+		}
+
+		return jsonSkipWhitespacesAndComments(this);
+	}
+
+	switch (field->type) {
+	case JSON_FIELD_BOOL:
+		if (!isalpha(*this->it) || jsonLexId(this, (bool*)member) != JSON_BOOL)
+			return jsonError(this, row, col, "Expected a bool for \"%s\"", name);
+		break;
+
+	case JSON_FIELD_INT: case JSON_FIELD_FLOAT: {
+		int64_t intValue;
+		double  floatValue;
+		if (!isdigit(*this->it) && *this->it != '-')
+			return jsonError(this, row, col, "Expected a number for \"%s\"", name);
+
+		ret = jsonLexNumber(this, &intValue, &floatValue);
+		if (ret == JSON_INT && field->type == JSON_FIELD_INT)
+			*(int64_t*)member = intValue;
+		else if (ret == JSON_INT)
+			*(double*)member = (double)intValue;
+		else if (ret == JSON_FLOAT && field->type == JSON_FIELD_FLOAT)
+			*(double*)member = floatValue;
+		else if (ret == JSON_FLOAT)
+			return jsonError(this, row, col, "Expected an integer for \"%s\"", name);
+		else
+			return -1;
+
+		ret = 0;
+	} break;
+
+	case JSON_FIELD_STRING: {
+		if (*this->it != '"')
+			return jsonError(this, row, col, "Expected a string for \"%s\"", name);
+
+		size_t length;
+		char  *str = jsonEscapeString(this, &length);
+		if (str == NULL)
+			return -1;
+
+		nochFree(*(char**)member);
+		*(char**)member = str;
+	} break;
+
+	case JSON_FIELD_STRUCT:
+		if (*this->it != '{')
+			return jsonError(this, row, col, "Expected an object for \"%s\"", name);
+
+		ret = jsonStructReadObj(this, field->fields, member);
+		break;
+
+	case JSON_FIELD_LIST: ret = jsonStructReadList(this, field, base); break;
+
+	default: nochAssert(0 && "Unknown field type");
+	}
+
+	if (ret != 0)
+		return ret;
+
+	return jsonSkipWhitespacesAndComments(this);
+}
+
+static int jsonStructReadObj(JsonParser *this, const JsonField *fields, char *base) {
+	nochAssert(*this->it == '{');
+
+	size_t startRow = this->row, startCol = JSON_COL(this);
+	++ this->it;
 
-	this->it += 2;
 	while (true) {
-		if (*this->it == '\n') {
-			++ this->row;
-			this->bol = this->it + 1;
-		} else if (*this->it == '\0')
-			return jsonError(this, row, col, "Comment not terminated");
-		else if (*this->it == '*' && this->it[1] == '/')
+		if (jsonSkipWhitespacesAndComments(this) != 0)
+			return -1;
+
+		if (*this->it == '}')
 			break;
+		else if (*this->it != '"')
+			return jsonError(this, this->row, JSON_COL(this), "Expected a key (string)");
+
+		/* Keys only live until they are looked up, values are allocated */
+		size_t length;
+		this->strings = JSON_STRINGS_SCRATCH;
+		const char *key = jsonEscapeString(this, &length);
+		this->strings = JSON_STRINGS_ALLOC;
+		if (key == NULL)
+			return -1;
+
+		const JsonField *field = jsonStructFind(fields, key);
+
+		if (jsonSkipWhitespacesAndComments(this) != 0)
+			return -1;
+
+		if (*this->it != ':')
+			return jsonError(this, this->row, JSON_COL(this), "Expected a \":\"");
+		++ this->it;
 
+		if (field == NULL) {
+			if (jsonSkipWhitespacesAndComments(this) != 0 || jsonLazySkip(this) != 0 ||
+			    jsonSkipWhitespacesAndComments(this) != 0)
+				return -1;
+		} else if (jsonStructReadValue(this, field, base) != 0)
+			return -1;
+
+		if (*this->it == '}')
+			break;
+		else if (*this->it != ',')
+			return jsonError(this, this->row, JSON_COL(this),
+			                 "Expected a matching \"}\" (for \"{\" at %lu:%lu)",
+			                 (long unsigned)startRow, (long unsigned)startCol);
 		++ this->it;
 	}
+	++ this->it;
 
-	this->it += 2;
 	return 0;
 }
 
-static int jsonSkipWhitespacesAndComments(JsonParser *this) {
-	while (*this->it != '\0') {
-		if (*this->it == '/' && this->it[1] == '*') {
-			if (jsonSkipComment(this) != 0)
-				return -1;
-		} else if (!isspace(*this->it))
-			break;
+static int jsonStructParse(const char *str, const char *end, const char *path,
+                           const JsonField *fields, void *out) {
+	JsonParser parser;
+	jsonParserInit(&parser, str, path);
+	parser.end     = end;
+	parser.strings = JSON_STRINGS_ALLOC;
+
+	int ret = -1;
+	if (jsonSkipWhitespacesAndComments(&parser) != 0)
+		goto out;
+
+	if (*parser.it != '{') {
+		jsonError(&parser, parser.row, JSON_COL(&parser), "Expected an object");
+		goto out;
+	}
+
+	if (jsonStructReadObj(&parser, fields, (char*)out) != 0 ||
+	    jsonSkipWhitespacesAndComments(&parser) != 0)
+		goto out;
+
+	if (*parser.it != '\0')
+		jsonError(&parser, parser.row, JSON_COL(&parser),
+		          "Unexpected character \"%c\" after end of JSON data", *parser.it);
+	else if (parser.end != NULL && parser.it != parser.end)
+		jsonError(&parser, parser.row, JSON_COL(&parser), "Unexpected NUL character in input");
+	else
+		ret = 0;
+
+out:
+	nochFree(parser.scratch);
+	return ret;
+}
+
+NOCH_DEF int jsonStructFromString(const char *str, const JsonField *fields, void *out) {
+	nochAssert(str != NULL && fields != NULL && out != NULL);
+	return jsonStructParse(str, NULL, NULL, fields, out);
+}
+
+NOCH_DEF int jsonStructFromFile(const char *path, const JsonField *fields, void *out) {
+	nochAssert(path != NULL && fields != NULL && out != NULL);
+
+	JsonFile file;
+	if (jsonReadFile(&file, path) != 0)
+		return -1;
+
+	int ret = jsonStructParse(file.data, file.data + file.size, path, fields, out);
+	jsonFileFree(&file);
+	return ret;
+}
+
+static void jsonStructWriteObj(JsonOutputStream *this, const JsonField *fields, const char *base,
+                               size_t indentSize);
+
+static void jsonStructWriteValue(JsonOutputStream *this, const JsonField *field, const char *base,
+                                 size_t indentSize) {
+	const char *member = base + field->offset;
+
+	switch (field->type) {
+	case JSON_FIELD_INT:   jsonWriteInt(this, *(const int64_t*)member);  break;
+	case JSON_FIELD_FLOAT: jsonWriteFloat(this, *(const double*)member); break;
+
+	case JSON_FIELD_BOOL:
+		if (*(const bool*)member)
+			jsonWriteLiteral(this, "true");
+		else
+			jsonWriteLiteral(this, "false");
+		break;
+
+	case JSON_FIELD_STRING: {
+		const char *str = *(char* const*)member;
+		if (str == NULL)
+			jsonWriteLiteral(this, "null");
+		else
+			jsonWriteString(this, str, strlen(str));
+	} break;
+
+	case JSON_FIELD_STRUCT: jsonStructWriteObj(this, field->fields, member, indentSize); break;
+
+	case JSON_FIELD_LIST: {
+		const char *items = *(char* const*)member;
+		size_t      count = *(const size_t*)(base + field->countOffset);
 
-		if (*this->it == '\n') {
-			++ this->row;
-			this->bol = this->it + 1;
+		jsonWriteChar(this, '[');
+		for (size_t i = 0; i < count; ++ i) {
+			if (i > 0)
+				jsonWriteChar(this, ',');
+
+			jsonNewLineIndent(this, indentSize + 1);
+			jsonStructWriteValue(this, field->fields, items + i * field->fields->size,
+			                     indentSize + 1);
 		}
 
-		++ this->it;
+		if (count > 0)
+			jsonNewLineIndent(this, indentSize);
+		jsonWriteChar(this, ']');
+	} break;
+
+	default: nochAssert(0 && "Unknown field type");
 	}
-	return 0;
 }
 
-static int jsonParseHex4(JsonParser *this, uint16_t *ret) {
-	nochAssert(ret != NULL);
+static void jsonStructWriteObj(JsonOutputStream *this, const JsonField *fields, const char *base,
+                               size_t indentSize) {
+	jsonWriteChar(this, '{');
+	for (const JsonField *field = fields; field->name != NULL; ++ field) {
+		if (field != fields)
+			jsonWriteChar(this, ',');
+
+		jsonNewLineIndent(this, indentSize + 1);
+		jsonWriteString(this, field->name, strlen(field->name));
+		if (this->indent == JSON_COMPACT)
+			jsonWriteChar(this, ':');
+		else
+			jsonWriteLiteral(this, ": ");
 
-	char buf[5] = {0};
-	for (size_t i = 0; i < 4; ++ i) {
-		if (!isxdigit(*this->it))
-			return jsonError(this, this->row, JSON_COL(this),
-			                 "Expected 4 hexadecimal digits, got \"%c\"", *this->it);
+		jsonStructWriteValue(this, field, base, indentSize + 1);
+	}
 
-		buf[i] = *this->it ++;
+	if (fields->name != NULL)
+		jsonNewLineIndent(this, indentSize);
+	jsonWriteChar(this, '}');
+}
+
+NOCH_DEF char *jsonStructStringify(const JsonField *fields, const void *in, int indent) {
+	nochAssert(fields != NULL && in != NULL);
+
+	JsonOutputStream outputStream;
+	jsonOutputInit(&outputStream, JSON_OUTPUT_STRING, indent);
+	outputStream.cap = 256;
+	outputStream.buf = (char*)jsonAlloc(NULL, outputStream.cap + 1);
+
+	jsonStructWriteObj(&outputStream, fields, (const char*)in, 0);
+	if (indent != JSON_COMPACT)
+		jsonWriteChar(&outputStream, '\n');
+
+	outputStream.buf[outputStream.size] = '\0';
+	return outputStream.buf;
+}
+
+typedef struct {
+	char   type; /* '{' or '[' */
+	size_t row, col;
+} JsonEventsLevel;
+
+enum {
+	JSON_EXPECT_VALUE = 0,
+	JSON_EXPECT_KEY,
+	JSON_EXPECT_COLON,
+	JSON_EXPECT_COMMA,
+	JSON_EXPECT_END,
+};
+
+/* The event parser follows the same grammar as jsonParseAtom, but keeps the open containers on an
+   explicit stack instead of recursing, so its memory only depends on the nesting depth */
+typedef struct {
+	JsonParser         parser;
+	const JsonHandler *handler;
+	void              *data;
+	int                expect;
+
+	JsonEventsLevel *stack;
+	size_t           depth, cap;
+	bool             done;
+} JsonEvents;
+
+#define JSON_EMIT(THIS, EVENT, ARGS)                                             \
+	do {                                                                         \
+		if ((THIS)->handler->EVENT != NULL) {                                    \
+			int ret_ = (THIS)->handler->EVENT ARGS;                              \
+			if (ret_ != 0)                                                       \
+				return ret_;                                                     \
+		}                                                                        \
+	} while (0)
+
+static int jsonEventsPush(JsonEvents *this, char type) {
+	if (this->depth >= JSON_MAX_DEPTH)
+		return jsonError(&this->parser, this->parser.row, JSON_COL(&this->parser),
+		                 "Exceeded the maximum nesting depth of %d", JSON_MAX_DEPTH);
+
+	if (this->depth >= this->cap) {
+		this->cap   = this->cap == 0? 16 : this->cap * 2;
+		this->stack = (JsonEventsLevel*)jsonRealloc(NULL, this->stack,
+		                                            this->depth * sizeof(JsonEventsLevel),
+		                                            this->cap   * sizeof(JsonEventsLevel));
 	}
 
-	*ret = strtol(buf, NULL, 16);
+	JsonEventsLevel *level = this->stack + this->depth ++;
+	level->type = type;
+	level->row  = this->parser.row;
+	level->col  = JSON_COL(&this->parser);
+	++ this->parser.it;
 	return 0;
 }
 
-static int jsonParseUnicodeSequence(JsonParser *this, char *str, size_t *end) {
-	size_t col = JSON_COL(this) - 1;
-	++ this->it;
+static void jsonEventsValueEnd(JsonEvents *this) {
+	this->expect = this->depth == 0? JSON_EXPECT_END : JSON_EXPECT_COMMA;
+}
 
-	uint32_t rune;
-	uint16_t first, second;
-	if (jsonParseHex4(this, &first) != 0)
-		return -1;
+static int jsonEventsClose(JsonEvents *this) {
+	char type = this->stack[-- this->depth].type;
+	++ this->parser.it;
 
-	/* Surrogate pair */
-	if (first >= 0xD800 && first <= 0xDBFF) {
-		if (*this->it == '\0')
-			return jsonError(this, this->row, col, "Expected a surrogate pair");
+	if (type == '{')
+		JSON_EMIT(this, objEnd, (this->data));
+	else
+		JSON_EMIT(this, listEnd, (this->data));
 
-		if (this->it[0] != '\\' || this->it[1] != 'u')
-			return jsonError(this, this->row, col, "Invalid unicode sequence");
+	jsonEventsValueEnd(this);
+	return 0;
+}
+
+static int jsonEventsAtom(JsonEvents *this) {
+	JsonParser *parser = &this->parser;
+	switch (*parser->it) {
+	case '\0': return jsonError(parser, parser->row, JSON_COL(parser), "Unexpected end of input");
+
+	case '{':
+		if (jsonEventsPush(this, '{') != 0)
+			return -1;
+
+		this->expect = JSON_EXPECT_KEY;
+		JSON_EMIT(this, objBegin, (this->data));
+		return 0;
+
+	case '[':
+		if (jsonEventsPush(this, '[') != 0)
+			return -1;
 
-		this->it += 2;
-		if (jsonParseHex4(this, &second) != 0)
+		this->expect = JSON_EXPECT_VALUE;
+		JSON_EMIT(this, listBegin, (this->data));
+		return 0;
+
+	case '"': {
+		size_t      length;
+		const char *str = jsonEscapeString(parser, &length);
+		if (str == NULL)
 			return -1;
 
-		if (second < 0xDC00 || second > 0xDFFF)
-			return jsonError(this, this->row, col, "Invalid unicode sequence");
+		jsonEventsValueEnd(this);
+		JSON_EMIT(this, string, (this->data, str, length));
+	} return 0;
 
-		rune = 0x10000 + (((first & 0x3FF) << 10) | (second & 0x3FF));
+	default: break;
+	}
+
+	if (isdigit(*parser->it) || *parser->it == '-') {
+		int64_t intValue;
+		double  floatValue;
+		switch (jsonLexNumber(parser, &intValue, &floatValue)) {
+		case JSON_INT:   jsonEventsValueEnd(this); JSON_EMIT(this, intx,   (this->data, intValue));   break;
+		case JSON_FLOAT: jsonEventsValueEnd(this); JSON_EMIT(this, floatx, (this->data, floatValue)); break;
+		default:         return -1;
+		}
+	} else if (isalpha(*parser->it)) {
+		bool value;
+		switch (jsonLexId(parser, &value)) {
+		case JSON_NULL: jsonEventsValueEnd(this); JSON_EMIT(this, null,  (this->data));        break;
+		case JSON_BOOL: jsonEventsValueEnd(this); JSON_EMIT(this, boolx, (this->data, value)); break;
+		default:        return -1;
+		}
 	} else
-		rune = first;
+		return jsonError(parser, parser->row, JSON_COL(parser),
+		                 "Unexpected character \"%c\"", *parser->it);
 
-	char out[5] = {0};
+	return 0;
+}
 
-	if (rune <= 0x7F)
-		out[0] = rune;
-	else if (rune <= 0x7FF) {
-		out[0] = (0xC0 | (rune >> 6));   /* 110xxxxx */
-		out[1] = (0x80 | (rune & 0x3F)); /* 10xxxxxx */
-	} else if (rune <= 0xFFFF) {
-		out[0] = (0xE0 | (rune >> 12));       /* 1110xxxx */
-		out[1] = (0x80 | (rune >> 6 & 0x3F)); /* 10xxxxxx */
-		out[2] = (0x80 | (rune & 0x3F));      /* 10xxxxxx */
-	} else if (rune <= 0x10FFFF) {
-		out[0] = 0xF0 | (rune >> 18);        /* 11110xxx */
-		out[1] = 0x80 | (rune >> 12 & 0x3F); /* 10xxxxxx */
-		out[2] = 0x80 | (rune >> 6  & 0x3F); /* 10xxxxxx */
-		out[3] = 0x80 | (rune & 0x3F);       /* 10xxxxxx */
-	} else
-		return jsonError(this, this->row, col, "Invalid unicode sequence");
+static int jsonEventsStep(JsonEvents *this) {
+	JsonParser *parser = &this->parser;
 
-	for (const char *it = out; *it != '\0'; ++ it)
-		str[(*end) ++] = *it;
+	if (jsonSkipWhitespacesAndComments(parser) != 0)
+		return -1;
 
-    return 0;
-}
+	int  ret = 0;
+	char ch  = *parser->it;
+	if (ch == '\0' && parser->partial)
+		return jsonNeedMore(parser, -1);
 
-static char *jsonEscapeString(JsonParser *this) {
-	nochAssert(*this->it == '"');
+	switch (this->expect) {
+	case JSON_EXPECT_VALUE:
+		/* Empty list or a trailing comma */
+		if (ch == ']' && this->depth > 0 && this->stack[this->depth - 1].type == '[')
+			ret = jsonEventsClose(this);
+		else
+			ret = jsonEventsAtom(this);
+		break;
 
-	size_t col = JSON_COL(this);
+	case JSON_EXPECT_KEY:
+		if (ch == '}')
+			ret = jsonEventsClose(this);
+		else if (ch != '"')
+			return jsonError(parser, parser->row, JSON_COL(parser), "Expected a key (string)");
+		else {
+			size_t      length;
+			const char *key = jsonEscapeString(parser, &length);
+			if (key == NULL)
+				return -1;
 
-	const char *start  = ++ this->it;
-	bool        escape = false;
-	while (escape || *this->it != '"') {
-		if (*this->it == '\0' || *this->it == '\n') {
-			jsonError(this, this->row, col, "String not terminated");
-			return NULL;
+			this->expect = JSON_EXPECT_COLON;
+			JSON_EMIT(this, key, (this->data, key, length));
 		}
+		break;
 
-		if (escape)
-			escape = false;
-		else if (*this->it == '\\')
-			escape = true;
+	case JSON_EXPECT_COLON:
+		if (ch != ':')
+			return jsonError(parser, parser->row, JSON_COL(parser), "Expected a \":\"");
 
-		++ this->it;
-	}
+		++ parser->it;
+		this->expect = JSON_EXPECT_VALUE;
+		break;
 
-	char *str = (char*)nochAlloc(this->it - start + 1);
-	if (str == NULL)
-		NOCH_OUT_OF_MEM();
+	case JSON_EXPECT_COMMA: {
+		JsonEventsLevel *level = this->stack + this->depth - 1;
+		char             close = level->type == '{'? '}' : ']';
+		if (ch == ',') {
+			++ parser->it;
+			this->expect = level->type == '{'? JSON_EXPECT_KEY : JSON_EXPECT_VALUE;
+		} else if (ch == close)
+			ret = jsonEventsClose(this);
+		else
+			return jsonError(parser, parser->row, JSON_COL(parser),
+			                 "Expected a matching \"%c\" (for \"%c\" at %lu:%lu)",
+			                 close, level->type, (long unsigned)level->row,
+			                 (long unsigned)level->col);
+	} break;
 
-	size_t end = 0;
-	this->it   = start;
-	while (escape || *this->it != '"') {
-		if (escape) {
-			escape = false;
-			char escaped;
-
-			switch (*this->it) {
-			case '"': case '\\': case '/':
-				escaped = *this->it;
-				break;
+	case JSON_EXPECT_END:
+		if (ch != '\0')
+			return jsonError(parser, parser->row, JSON_COL(parser),
+			                 "Unexpected character \"%c\" after end of JSON data", ch);
 
-			case 'b': escaped = '\b';   break;
-			case 'f': escaped = '\f';   break;
-			case 'n': escaped = '\n';   break;
-			case 'r': escaped = '\r';   break;
-			case 't': escaped = '\t';   break;
-			case 'e': escaped = '\x1b'; break; /* Not standard!!!! but useful */
-
-			case 'u':
-				if (jsonParseUnicodeSequence(this, str, &end) != 0) {
-					nochFree(str);
-					return NULL;
-				}
-				continue;
+		this->done = true;
+		break;
 
-			default:
-				jsonError(this, this->row, JSON_COL(this),
-				          "Unknown escape sequence \"\\%c\"", *this->it);
-				nochFree(str);
-				return NULL;
-			}
+	default: nochAssert(0 && "Unknown parser state");
+	}
 
-			str[end ++] = escaped;
-		} else if (*this->it == '\\')
-			escape = true;
-		else
-			str[end ++] = *this->it;
+	return ret;
+}
 
-		++ this->it;
+static int jsonEventsRun(JsonEvents *this) {
+	JsonParser *parser = &this->parser;
+	while (!this->done) {
+		/* A token cut off by the end of partial input is retried from here once more arrives */
+		const char *it = parser->it, *bol = parser->bol;
+		size_t      row = parser->row, colBase = parser->colBase;
+
+		parser->needMore = 0;
+
+		int ret = jsonEventsStep(this);
+		if (ret == -1 && parser->needMore != 0) {
+			parser->it      = it;
+			parser->bol     = bol;
+			parser->row     = row;
+			parser->colBase = colBase;
+			return 0;
+		} else if (ret != 0)
+			return ret;
 	}
 
-	++ this->it;
-	str[end] = '\0';
-	return str;
+	return 0;
 }
 
-static Json *jsonParseAtom(JsonParser *this);
+static void jsonEventsInit(JsonEvents *this, const char *str, const char *path,
+                           const JsonHandler *handler, void *data) {
+	memset(this, 0, sizeof(*this));
+	jsonParserInit(&this->parser, str, path);
+	this->handler        = handler;
+	this->data           = data;
+	this->parser.strings = JSON_STRINGS_SCRATCH;
+}
 
-static Json *jsonParseObj(JsonParser *this) {
-	nochAssert(*this->it == '{');
+static void jsonEventsDeinit(JsonEvents *this) {
+	nochFree(this->stack);
+	nochFree(this->parser.scratch);
+}
 
-	size_t startRow = this->row, startCol = JSON_COL(this);
+struct JsonPushParser {
+	JsonEvents events;
 
-	JsonObj *obj = jsonNewObj();
-	++ this->it;
+	char  *buf; /* Unparsed input, NUL terminated */
+	size_t size, cap;
+	int    ret; /* Non-zero once parsing failed or was stopped */
+};
 
-	while (*this->it != '}') {
-		if (jsonSkipWhitespacesAndComments(this) != 0)
-			goto fail;
+static JsonPushParser *jsonPushParserNew_(const char *path, const JsonHandler *handler, void *data) {
+	JsonPushParser *this = (JsonPushParser*)jsonAlloc(NULL, sizeof(JsonPushParser));
+	this->size = 0;
+	this->cap  = JSON_READ_CHUNK_SIZE;
+	this->buf  = (char*)jsonAlloc(NULL, this->cap);
+	this->ret  = 0;
+	*this->buf = '\0';
 
-		if (*this->it != '"') {
-			jsonError(this, this->row, JSON_COL(this), "Expected a key (string)");
-			goto fail;
-		}
+	jsonEventsInit(&this->events, this->buf, path, handler, data);
+	this->events.parser.partial = true;
+	return this;
+}
 
-		size_t col = JSON_COL(this);
-		char  *key = jsonEscapeString(this);
-		if (key == NULL)
-			goto fail;
+NOCH_DEF JsonPushParser *jsonPushParserNew(const JsonHandler *handler, void *data) {
+	nochAssert(handler != NULL);
+	return jsonPushParserNew_(NULL, handler, data);
+}
 
-		size_t prevSize = obj->size;
-		Json **ref = jsonObjSet(obj, key, NULL);
-		if (obj->size == prevSize) {
-			jsonError(this, this->row, col,
-			          "Duplicate key \"%s\" in object", key);
-			nochFree(key);
-			goto fail;
-		}
-		nochFree(key);
+NOCH_DEF void jsonPushParserDestroy(JsonPushParser *this) {
+	nochAssert(this != NULL);
 
-		if (jsonSkipWhitespacesAndComments(this) != 0)
-			goto fail;
+	jsonEventsDeinit(&this->events);
+	nochFree(this->buf);
+	nochFree(this);
+}
 
-		if (*this->it != ':') {
-			jsonError(this, this->row, JSON_COL(this), "Expected a \":\"");
-			goto fail;
-		}
-		++ this->it;
+NOCH_DEF int jsonPushParserFeed(JsonPushParser *this, const char *buf, size_t size) {
+	nochAssert(this != NULL && (buf != NULL || size == 0));
 
-		Json *json = jsonParseAtom(this);
-		if (json == NULL)
-			goto fail;
+	if (this->ret != 0)
+		return this->ret;
 
-		*ref = json;
+	JsonParser *parser = &this->events.parser;
+	if (size > 0 && memchr(buf, '\0', size) != NULL) {
+		jsonError(parser, parser->row, JSON_COL(parser), "Unexpected NUL character in input");
+		return this->ret = -1;
+	}
 
-		if (*this->it == ',')
-			++ this->it;
-		else if (*this->it != '}') {
-			jsonError(this, this->row, JSON_COL(this),
-			          "Expected a matching \"}\" (for \"{\" at %lu:%lu)",
-			          (long unsigned)startRow, (long unsigned)startCol);
-			goto fail;
-		}
+	/* Drop the parsed input, keeping the columns of a line that started in it */
+	size_t consumed = parser->it - this->buf;
+	parser->colBase += parser->it - parser->bol;
+
+	this->size -= consumed;
+	memmove(this->buf, this->buf + consumed, this->size);
+
+	if (this->size + size + 1 > this->cap) {
+		while (this->size + size + 1 > this->cap)
+			this->cap *= 2;
+
+		this->buf = (char*)jsonRealloc(NULL, this->buf, this->size, this->cap);
 	}
-	++ this->it;
 
-	return (Json*)obj;
+	memcpy(this->buf + this->size, buf, size);
+	this->size += size;
+	this->buf[this->size] = '\0';
 
-fail:
-	jsonDestroy(obj);
-	return NULL;
-}
+	parser->in  = this->buf;
+	parser->it  = this->buf;
+	parser->bol = this->buf;
 
-static Json *jsonParseList(JsonParser *this) {
-	nochAssert(*this->it == '[');
+	/* A string or comment cut off by the previous chunk can not be completed without its
+	   terminating character, so don't rescan it until that arrives */
+	if (parser->needMore > 0 && (size == 0 || memchr(buf, parser->needMore, size) == NULL))
+		return 0;
 
-	size_t startRow = this->row, startCol = JSON_COL(this);
+	return this->ret = jsonEventsRun(&this->events);
+}
 
-	JsonList *list = jsonNewList();
-	++ this->it;
+NOCH_DEF int jsonPushParserFinish(JsonPushParser *this) {
+	nochAssert(this != NULL);
 
-	if (jsonSkipWhitespacesAndComments(this) != 0)
-		goto fail;
+	if (this->ret != 0)
+		return this->ret;
 
-	while (*this->it != ']') {
-		Json *json = jsonParseAtom(this);
-		if (json == NULL)
-			goto fail;
+	this->events.parser.partial = false;
+	return this->ret = jsonEventsRun(&this->events);
+}
 
-		jsonListPush(list, json);
+NOCH_DEF int jsonEventsFromFile(const char *path, const JsonHandler *handler, void *data) {
+	nochAssert(path != NULL && handler != NULL);
 
-		if (*this->it == ',')
-			++ this->it;
-		else if (*this->it != ']') {
-			jsonError(this, this->row, JSON_COL(this),
-			          "Expected a matching \"]\" (for \"[\" at %lu:%lu)",
-			          (long unsigned)startRow, (long unsigned)startCol);
-			goto fail;
+	FILE *file = fopen(path, "r");
+	if (file == NULL)
+		return nochErrorAt(NOCH_ERROR_IO, path, 0, 0, "Failed to open file");
+
+	/* Read in chunks, so memory use does not depend on the size of the file */
+	JsonPushParser *parser = jsonPushParserNew_(path, handler, data);
+	char           *chunk  = (char*)jsonAlloc(NULL, JSON_READ_CHUNK_SIZE);
+
+	int ret = 0;
+	while (ret == 0) {
+		size_t size = fread(chunk, 1, JSON_READ_CHUNK_SIZE, file);
+		if (size == 0) {
+			if (ferror(file))
+				ret = nochErrorAt(NOCH_ERROR_IO, path, 0, 0, "Failed to read file");
+			else
+				ret = jsonPushParserFinish(parser);
+			break;
 		}
+
+		ret = jsonPushParserFeed(parser, chunk, size);
 	}
-	++ this->it;
 
-	return (Json*)list;
+	nochFree(chunk);
+	jsonPushParserDestroy(parser);
+	fclose(file);
+	return ret;
+}
 
-fail:
-	jsonDestroy(list);
-	return NULL;
+NOCH_DEF int jsonEventsFromString(const char *str, const JsonHandler *handler, void *data) {
+	nochAssert(str != NULL && handler != NULL);
+
+	JsonEvents events;
+	jsonEventsInit(&events, str, NULL, handler, data);
+
+	int ret = jsonEventsRun(&events);
+	jsonEventsDeinit(&events);
+	return ret;
 }
 
-static bool stringViewEqualsString(const char *view, size_t len, const char *str) {
-	if (strncmp(view, str, len) != 0)
-		return false;
-	else
-		return strlen(str) == len;
+typedef struct {
+	size_t offset, length, line; /* The text of the line is at the offset of the input */
+	Json  *json;
+	bool   done;
+} JsonLine;
+
+typedef struct {
+	JsonLinesCallback callback;
+	void             *data;
+	const char       *path;
+	bool              ordered;
+
+	const char *in; /* Input the lines are in, it only moves between batches */
+	JsonLine   *lines;
+	size_t    count;             /* Lines of the current batch */
+	size_t    queued, claimed;   /* Lines handed to the workers, lines taken by them */
+	size_t   *finished;          /* Indices of parsed lines in the order they were finished */
+	size_t    finishedCount;
+	size_t    threadsCount;
+
+	char  *scratch; /* Copy of the line being parsed when there are no workers */
+	size_t scratchCap;
+
+#ifdef JSON_THREADS
+	pthread_t      *threads;
+	pthread_mutex_t mutex;
+	pthread_cond_t  work, done;
+	bool            quit;
+#endif
+} JsonLines;
+
+/* Lines are not NUL terminated inside of the input, so each one is parsed from a copy. The parser
+   knows where the line ends, so a NUL inside of it is an error instead of its end */
+static Json *jsonLinesParse(JsonLines *this, JsonLine *line, char **scratch, size_t *scratchCap,
+                            bool quiet) {
+	if (line->length + 1 > *scratchCap) {
+		*scratchCap = line->length + 1 > *scratchCap * 2? line->length + 1 : *scratchCap * 2;
+		*scratch    = (char*)jsonRealloc(NULL, *scratch, 0, *scratchCap);
+	}
+
+	memcpy(*scratch, this->in + line->offset, line->length);
+	(*scratch)[line->length] = '\0';
+
+	JsonParser parser;
+	jsonParserInit(&parser, *scratch, this->path);
+	parser.end   = *scratch + line->length;
+	parser.row   = line->line;
+	parser.quiet = quiet;
+	return jsonParseRoot(&parser);
 }
 
-static Json *jsonParseId(JsonParser *this) {
-	nochAssert(isalpha(*this->it));
+#ifdef JSON_THREADS
+static void *jsonLinesWorker(void *arg) {
+	JsonLines *this       = (JsonLines*)arg;
+	char      *scratch    = NULL;
+	size_t     scratchCap = 0;
 
-	size_t col = JSON_COL(this);
+	pthread_mutex_lock(&this->mutex);
+	while (true) {
+		while (!this->quit && this->claimed >= this->queued)
+			pthread_cond_wait(&this->work, &this->mutex);
 
-	const char *start = this->it;
-	while (isalnum(*this->it ++));
+		if (this->quit)
+			break;
 
-	size_t len = -- this->it - start;
-	if (stringViewEqualsString(start, len, "null"))
-		return jsonNull();
-	else if (stringViewEqualsString(start, len, "true"))
-		return (Json*)jsonNewBool(true);
-	else if (stringViewEqualsString(start, len, "false"))
-		return (Json*)jsonNewBool(false);
+		JsonLine *line = this->lines + this->claimed ++;
+		pthread_mutex_unlock(&this->mutex);
+
+		Json *json = jsonLinesParse(this, line, &scratch, &scratchCap, true);
+
+		pthread_mutex_lock(&this->mutex);
+		line->json = json;
+		line->done = true;
+		this->finished[this->finishedCount ++] = line - this->lines;
+		pthread_cond_signal(&this->done);
+	}
+	pthread_mutex_unlock(&this->mutex);
 
-	jsonError(this, this->row, col, "Unknown identifier \"%.*s\"", (int)len, start);
+	nochFree(scratch);
 	return NULL;
 }
+#endif
 
-static Json *jsonParseString(JsonParser *this) {
-	char *str = jsonEscapeString(this);
-	if (str == NULL)
-		return NULL;
+static JsonLine *jsonLinesNext(JsonLines *this, size_t delivered) {
+	JsonLine *line;
+#ifdef JSON_THREADS
+	if (this->threadsCount > 0) {
+		pthread_mutex_lock(&this->mutex);
+		if (this->ordered) {
+			line = this->lines + delivered;
+			while (!line->done)
+				pthread_cond_wait(&this->done, &this->mutex);
+		} else {
+			while (this->finishedCount <= delivered)
+				pthread_cond_wait(&this->done, &this->mutex);
+
+			line = this->lines + this->finished[delivered];
+		}
+		pthread_mutex_unlock(&this->mutex);
+		return line;
+	}
+#endif
 
-	return (Json*)jsonNewString_(str);
+	line       = this->lines + delivered;
+	line->json = jsonLinesParse(this, line, &this->scratch, &this->scratchCap, false);
+	line->done = true;
+	return line;
 }
 
-static Json *jsonParseNumber(JsonParser *this) {
-	nochAssert(isdigit(*this->it) || *this->it == '-');
-
-	bool exponent = false, floatingPoint = false;
+static int jsonLinesBatch(JsonLines *this) {
+#ifdef JSON_THREADS
+	if (this->threadsCount > 0) {
+		pthread_mutex_lock(&this->mutex);
+		this->queued        = this->count;
+		this->claimed       = 0;
+		this->finishedCount = 0;
+		pthread_cond_broadcast(&this->work);
+		pthread_mutex_unlock(&this->mutex);
+	}
+#endif
 
-	const char *start = this->it;
-	if (*this->it == '-') {
-		++ this->it;
-		if (!isdigit(*this->it)) {
-			jsonError(this, this->row, JSON_COL(this), "Expected a number after \"-\"");
-			return NULL;
+	int    ret = 0;
+	size_t delivered;
+	for (delivered = 0; delivered < this->count; ++ delivered) {
+		JsonLine *line = jsonLinesNext(this, delivered);
+		if (line->json == NULL) {
+			/* Errors are kept per thread and workers parse quietly, so the error comes from parsing
+			   the line again on this thread */
+			if (this->threadsCount > 0)
+				jsonLinesParse(this, line, &this->scratch, &this->scratchCap, false);
+
+			ret = -1;
+			break;
 		}
+
+		Json *json = line->json;
+		line->json = NULL;
+
+		ret = this->callback(this->data, line->line, json);
+		if (ret != 0)
+			break;
 	}
 
-	while (true) {
-		if (*this->it == 'e') {
-			if (exponent) {
-				jsonError(this, this->row, JSON_COL(this), "Encountered exponent in number twice");
-				return NULL;
-			}
+#ifdef JSON_THREADS
+	/* Stop handing out lines and wait for the ones being parsed */
+	if (this->threadsCount > 0) {
+		pthread_mutex_lock(&this->mutex);
+		this->queued = this->claimed;
+		while (this->finishedCount < this->claimed)
+			pthread_cond_wait(&this->done, &this->mutex);
+
+		this->queued  = 0;
+		this->claimed = 0;
+		pthread_mutex_unlock(&this->mutex);
+	}
+#endif
 
-			exponent = true;
-			if (this->it[1] == '+' || this->it[1] == '-')
-				++ this->it;
+	for (size_t i = 0; i < this->count; ++ i) {
+		if (this->lines[i].done && this->lines[i].json != NULL)
+			jsonDestroy(this->lines[i].json);
+	}
 
-			if (!isdigit(this->it[1])) {
-				jsonError(this, this->row, JSON_COL(this), "expected a digit after exponent");
-				return NULL;
-			}
-		} else if (*this->it == '.') {
-			if (floatingPoint) {
-				jsonError(this, this->row, JSON_COL(this),
-				          "Encountered floating point in number twice");
-				return NULL;
-			} else if (exponent) {
-				jsonError(this, this->row, JSON_COL(this), "Unexpected floating point in exponent");
-				return NULL;
-			}
+	this->count = 0;
+	return ret;
+}
 
-			floatingPoint = true;
-			if (!isdigit(this->it[1])) {
-				jsonError(this, this->row, JSON_COL(this), "expected a digit after floating point");
-				return NULL;
+/* Splits complete lines off the input and parses them once there is a full batch. The input has to
+   stay until jsonLinesFlush parses the rest */
+static int jsonLinesFeed(JsonLines *this, const char *buf, size_t size, size_t *lineNum) {
+	const char *it = buf, *end = buf + size;
+	while (it < end) {
+		const char *eol = (const char*)memchr(it, '\n', end - it);
+		if (eol == NULL)
+			eol = end;
+
+		++ *lineNum;
+
+		const char *ch = it;
+		while (ch < eol && isspace(*ch))
+			++ ch;
+
+		if (ch < eol) {
+			JsonLine *line = this->lines + this->count ++;
+			line->offset = it - this->in;
+			line->length = eol - it;
+			line->line   = *lineNum;
+			line->json   = NULL;
+			line->done   = false;
+
+			if (this->count >= JSON_LINES_BATCH_SIZE) {
+				int ret = jsonLinesBatch(this);
+				if (ret != 0)
+					return ret;
 			}
-		} else if (*this->it == '-' || isalpha(*this->it)) {
-			jsonError(this, this->row, JSON_COL(this),
-			          "Unexpected character \"%c\" in number", *this->it);
-			return NULL;
-		} else if (!isdigit(*this->it))
-			break;
+		}
 
-		++ this->it;
+		it = eol + 1;
 	}
 
-	if (exponent || floatingPoint)
-		return (Json*)jsonNewFloat(atof(start));
-	else
-		return (Json*)jsonNewInt((int16_t)atoll(start));
+	return 0;
 }
 
-static Json *jsonParseAtom(JsonParser *this) {
-	if (jsonSkipWhitespacesAndComments(this) != 0)
-		return NULL;
+static int jsonLinesFlush(JsonLines *this) {
+	return this->count > 0? jsonLinesBatch(this) : 0;
+}
 
-	Json *parsed;
-	switch (*this->it) {
-	case '\0':
-		jsonError(this, this->row, JSON_COL(this), "Unexpected end of input");
-		return NULL;
+static void jsonLinesInit(JsonLines *this, const char *path, size_t threads, bool ordered,
+                          JsonLinesCallback callback, void *data) {
+	memset(this, 0, sizeof(*this));
+	this->callback = callback;
+	this->data     = data;
+	this->path     = path;
+	this->ordered  = ordered;
+	this->lines    = (JsonLine*)jsonAlloc(NULL, JSON_LINES_BATCH_SIZE * sizeof(JsonLine));
+	this->finished = (size_t*)  jsonAlloc(NULL, JSON_LINES_BATCH_SIZE * sizeof(size_t));
+
+#ifdef JSON_THREADS
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads   = cpus > 0? (size_t)cpus : 1;
+	}
 
-	case '{': parsed = jsonParseObj(this);    break;
-	case '[': parsed = jsonParseList(this);   break;
-	case '"': parsed = jsonParseString(this); break;
+	/* A single worker would only add synchronization on top of parsing on this thread */
+	if (threads <= 1)
+		return;
 
-	default:
-		if (isdigit(*this->it) || *this->it == '-')
-			parsed = jsonParseNumber(this);
-		else if (isalpha(*this->it))
-			parsed = jsonParseId(this);
-		else {
-			jsonError(this, this->row, JSON_COL(this), "Unexpected character \"%c\"", *this->it);
-			return NULL;
-		}
-	}
+	pthread_mutex_init(&this->mutex, NULL);
+	pthread_cond_init(&this->work, NULL);
+	pthread_cond_init(&this->done, NULL);
 
-	if (jsonSkipWhitespacesAndComments(this) != 0) {
-		jsonDestroy(parsed);
-		return NULL;
-	}
+	this->threads = (pthread_t*)jsonAlloc(NULL, threads * sizeof(pthread_t));
+	for (size_t i = 0; i < threads; ++ i) {
+		if (pthread_create(this->threads + i, NULL, jsonLinesWorker, this) != 0)
+			break;
 
-	return parsed;
+		++ this->threadsCount;
+	}
+#else
+	(void)threads;
+#endif
 }
 
-static Json *jsonParse(const char *str, const char *path) {
-	JsonParser parser = {0};
-	parser.path = path;
-	parser.in   = str;
-	parser.it   = str;
-	parser.bol  = str;
-	parser.row  = 1;
-
-	Json *json = jsonParseAtom(&parser);
-	if (json != NULL && *parser.it != '\0') {
-		jsonError(&parser, parser.row, JSON_COL(&parser),
-		          "Unexpected character \"%c\" after end of JSON data", *parser.it);
-		jsonDestroy(json);
-		return NULL;
+static void jsonLinesDeinit(JsonLines *this) {
+#ifdef JSON_THREADS
+	if (this->threads != NULL) {
+		pthread_mutex_lock(&this->mutex);
+		this->quit = true;
+		pthread_cond_broadcast(&this->work);
+		pthread_mutex_unlock(&this->mutex);
+
+		for (size_t i = 0; i < this->threadsCount; ++ i)
+			pthread_join(this->threads[i], NULL);
+
+		pthread_cond_destroy(&this->done);
+		pthread_cond_destroy(&this->work);
+		pthread_mutex_destroy(&this->mutex);
+		nochFree(this->threads);
 	}
+#endif
 
-	return json;
+	nochFree(this->scratch);
+	nochFree(this->finished);
+	nochFree(this->lines);
 }
 
-NOCH_DEF Json *jsonFromFile(const char *path) {
-	nochAssert(path != NULL);
+NOCH_DEF int jsonLinesFromFile(const char *path, size_t threads, bool ordered,
+                               JsonLinesCallback callback, void *data) {
+	nochAssert(path != NULL && callback != NULL);
 
 	FILE *file = fopen(path, "r");
-	if (file == NULL) {
-		nochError("%s: Failed to open file", path);
-		return NULL;
-	}
-
-	fseek(file, 0, SEEK_END);
-	size_t size = (size_t)ftell(file);
-	rewind(file);
+	if (file == NULL)
+		return nochErrorAt(NOCH_ERROR_IO, path, 0, 0, "Failed to open file");
+
+	JsonLines lines;
+	jsonLinesInit(&lines, path, threads, ordered, callback, data);
+
+	/* The buffer holds the lines of the batch that is not full yet, then the ones not fed yet */
+	size_t size = 0, fed = 0, cap = JSON_READ_CHUNK_SIZE * 16, lineNum = 0;
+	char  *buf  = (char*)jsonAlloc(NULL, cap);
+	lines.in = buf;
+
+	int ret = 0;
+	while (ret == 0) {
+		if (size == cap) {
+			/* Drop what has been parsed already, or make room if nothing has */
+			size_t keep = lines.count > 0? lines.lines[0].offset : fed;
+			if (keep > 0) {
+				memmove(buf, buf + keep, size - keep);
+				size -= keep;
+				fed  -= keep;
+				for (size_t i = 0; i < lines.count; ++ i)
+					lines.lines[i].offset -= keep;
+			} else {
+				cap     *= 2;
+				buf      = (char*)jsonRealloc(NULL, buf, size, cap);
+				lines.in = buf;
+			}
+		}
 
-	if (size == 0) {
-		nochError("%s: File is empty", path);
-		return NULL;
-	}
+		size_t read = fread(buf + size, 1, cap - size, file);
+		if (read == 0) {
+			if (ferror(file))
+				ret = nochErrorAt(NOCH_ERROR_IO, path, 0, 0, "Failed to read file");
+			else if ((ret = jsonLinesFeed(&lines, buf + fed, size - fed, &lineNum)) == 0)
+				ret = jsonLinesFlush(&lines);
+			break;
+		}
+		size += read;
 
-	char *str = (char*)nochAlloc(size + 1);
-	if (str == NULL)
-		NOCH_OUT_OF_MEM();
+		/* Feed the complete lines, the last one might continue in the next read */
+		size_t complete = size;
+		while (complete > fed && buf[complete - 1] != '\n')
+			-- complete;
 
-	if (fread(str, size, 1, file) <= 0) {
-		nochError("%s: Failed to read file", path);
-		return NULL;
+		if (complete > fed) {
+			ret = jsonLinesFeed(&lines, buf + fed, complete - fed, &lineNum);
+			fed = complete;
+		}
 	}
 
-	str[size] = '\0';
+	nochFree(buf);
+	jsonLinesDeinit(&lines);
 	fclose(file);
-
-	Json *json = jsonParse(str, path);
-	free(str);
-	return json;
+	return ret;
 }
 
-NOCH_DEF Json *jsonFromString(const char *str) {
-	nochAssert(str != NULL);
-	return jsonParse(str, NULL);
+NOCH_DEF int jsonLinesFromString(const char *str, size_t threads, bool ordered,
+                                 JsonLinesCallback callback, void *data) {
+	nochAssert(str != NULL && callback != NULL);
+
+	JsonLines lines;
+	jsonLinesInit(&lines, NULL, threads, ordered, callback, data);
+	lines.in = str;
+
+	size_t lineNum = 0;
+	int    ret     = jsonLinesFeed(&lines, str, strlen(str), &lineNum);
+	if (ret == 0)
+		ret = jsonLinesFlush(&lines);
+
+	jsonLinesDeinit(&lines);
+	return ret;
 }
 
 #undef JSON_COL
+#undef JSON_CBOR_FALSE
+#undef JSON_CBOR_TRUE
+#undef JSON_CBOR_NULL
+#undef JSON_CBOR_UNDEFINED
+#undef JSON_CBOR_HALF
+#undef JSON_CBOR_SINGLE
+#undef JSON_CBOR_DOUBLE
+#undef JSON_CBOR_BREAK
+#undef JSON_CBOR_INDEFINITE
+#undef JSON_NEEDS_ESCAPE
+#undef jsonWriteLiteral
+#undef JSON_MAX_EXACT_MANTISSA
+#undef JSON_MAX_EXPONENT
+#undef JSON_SIMD_SCAN
+#undef JSON_IS_STRING_SPECIAL
+#undef JSON_EMIT
+#undef JSON_NPOS
+#undef JSON_ARENA_ALIGN
+#undef JSON_ARENA_BLOCK_DATA
 
 #ifdef __cplusplus
 }
@@ -5,8 +5,11 @@ extern "C" {
 #endif
 
 #include <stdio.h>   /* fread, fprintf, fopen, fclose, FILE, fseek, SEEK_END, rewind, ftell */
-#include <stdint.h>  /* int64_t, uint32_t, uint16_t */
-#include <stdlib.h>  /* atoll, atof, strtol */
+#include <stddef.h>  /* offsetof */
+#include <stdint.h>  /* int64_t, uint32_t, uint16_t, uintptr_t */
+#include <stdlib.h>  /* strtod, strtol */
+#include <float.h>   /* FLT_EVAL_METHOD */
+#include <math.h>    /* INFINITY, NAN */
 #include <stdarg.h>  /* va_list, va_start, va_end, vsnprintf */
 #include <string.h>  /* memset, strlen, strcpy */
 #include <ctype.h>   /* isspace, isalnum, isalpha, isdigit, isxdigit */
@@ -14,6 +17,43 @@ extern "C" {
 
 #include "internal/def.h"
 #include "internal/error.h"
+#include "platform.h"
+
+#if defined(PLATFORM_LINUX) || defined(PLATFORM_UNIX) || defined(PLATFORM_APPLE)
+#	define JSON_POSIX
+#	include <errno.h> /* errno, EINTR */
+#	include "unix.h"  /* write, close, sysconf, _SC_PAGESIZE, _SC_NPROCESSORS_ONLN */
+#endif
+
+/* Worker threads of the JSON Lines reader, without them records are parsed one by one */
+#if !defined(JSON_NO_THREADS) && defined(JSON_POSIX)
+#	define JSON_THREADS
+#	include <pthread.h> /* pthread_t, pthread_mutex_t, pthread_cond_t, pthread_create, pthread_join */
+#endif
+
+/* Files are parsed straight from memory mapped pages, without them they are read into a copy */
+#if !defined(JSON_NO_MMAP) && defined(JSON_POSIX)
+#	define JSON_MMAP
+#	include <sys/mman.h> /* mmap, munmap, PROT_READ, MAP_PRIVATE, MAP_FAILED */
+#	include <sys/stat.h> /* fstat, struct stat */
+#	include <fcntl.h>    /* open, O_RDONLY */
+#endif
+
+/* Whitespace and strings are scanned in blocks of 32 (AVX2) or 16 (SSE2) bytes */
+#if !defined(JSON_NO_SIMD) && (defined(COMPILER_GCC) || defined(COMPILER_CLANG))
+#	if defined(__AVX2__)
+#		define JSON_AVX2
+#		include <immintrin.h> /* __m256i, _mm256_load_si256, _mm256_cmpeq_epi8, _mm256_movemask_epi8 */
+#	elif defined(__SSE2__)
+#		define JSON_SSE2
+#		include <emmintrin.h> /* __m128i, _mm_load_si128, _mm_cmpeq_epi8, _mm_movemask_epi8 */
+#	endif
+#endif
+
+/* Documents keep a single copy of each distinct object key, shared by all of their objects */
+#ifndef JSON_NO_INTERN
+#	define JSON_INTERN
+#endif
 
 enum {
 	JSON_NULL = 0,
@@ -29,18 +69,49 @@ enum {
 
 const char *jsonTypeToString(int type);
 
+/* Containers start out without a buffer, which gets this many slots when the first item is added
+   and doubles from there */
 #ifndef JSON_LIST_CHUNK_SIZE
-#	define JSON_LIST_CHUNK_SIZE 64
+#	define JSON_LIST_CHUNK_SIZE 4
 #endif
 
 #ifndef JSON_OBJ_CHUNK_SIZE
-#	define JSON_OBJ_CHUNK_SIZE 64
+#	define JSON_OBJ_CHUNK_SIZE 4
+#endif
+
+/* Lists and objects nested deeper than this are rejected by the parsers */
+#ifndef JSON_MAX_DEPTH
+#	define JSON_MAX_DEPTH 1024
+#endif
+
+/* Objects with more keys than this get a hash index, smaller ones are scanned linearly */
+#ifndef JSON_OBJ_INDEX_THRESHOLD
+#	define JSON_OBJ_INDEX_THRESHOLD 8
 #endif
 
+/* Size of the buffer output is collected in before it is written to a file */
+#ifndef JSON_WRITE_BUFFER_SIZE
+#	define JSON_WRITE_BUFFER_SIZE (16 * 1024)
+#endif
+
+/* Blocks of a document arena are used for all nodes at least this big */
+#ifndef JSON_ARENA_BLOCK_SIZE
+#	define JSON_ARENA_BLOCK_SIZE (64 * 1024)
+#endif
+
+enum {
+	JSON_FLAG_ARENA = 1 << 0, /* Node memory is owned by a JsonDoc arena */
+};
+
 typedef struct {
-	int type;
+	int type, flags;
 } Json;
 
+typedef struct {
+	struct JsonArenaBlock *head;
+	struct JsonKeys       *keys; /* Interned object keys, NULL when keys are not interned */
+} JsonArena;
+
 typedef struct {
 	Json base;
 
@@ -69,8 +140,9 @@ typedef struct {
 typedef struct {
 	Json base;
 
-	Json **buf;
-	size_t cap, size;
+	Json     **buf;
+	size_t     cap, size;
+	JsonArena *arena;
 } JsonList;
 
 #define FOREACH_IN_JSON_LIST(THIS, VAR, BODY)                          \
@@ -82,16 +154,24 @@ typedef struct {
 	} while (0)
 
 typedef struct {
-	char *key;
-	Json *value;
+	char    *key;
+	unsigned hash;
+	Json    *value;
 } JsonObjBucket;
 
-/* TODO: Make JsonObj use a hash map */
+/* Buckets are kept in insertion order, removed keys leave a hole (NULL key) behind. Holes are
+   reclaimed (keeping the order) when the buckets fill up, or by jsonObjShrink. The index is an open
+   addressing table of bucket indices (plus 1, 0 marks an empty slot) */
 typedef struct {
 	Json base;
 
 	JsonObjBucket *buckets;
 	size_t         cap, size;
+
+	size_t *index;
+	size_t  indexCap;
+
+	JsonArena *arena;
 } JsonObj;
 
 #define FOREACH_IN_JSON_OBJ(THIS, VALUE, KEY, BODY)                    \
@@ -125,25 +205,276 @@ NOCH_DEF JsonObj    *jsonNewObj   (void);
 NOCH_DEF Json **jsonObjAt (JsonObj  *this, const char *key);
 NOCH_DEF Json **jsonListAt(JsonList *this, size_t      idx);
 
-#define jsonObjSet(THIS, KEY, JSON) jsonObjSet_ (THIS, KEY, (Json*)JSON)
-#define jsonListPush(THIS, JSON)    jsonListPush_(THIS, (Json*)JSON)
+#define jsonObjSet(THIS, KEY, JSON)     jsonObjSet_    (THIS, KEY, (Json*)JSON)
+#define jsonListPush(THIS, JSON)        jsonListPush_  (THIS, (Json*)JSON)
+#define jsonListInsert(THIS, IDX, JSON) jsonListInsert_(THIS, IDX, (Json*)JSON)
 
 NOCH_DEF Json **jsonObjSet_  (JsonObj  *this, const char *key, Json *json);
 NOCH_DEF int    jsonObjRemove(JsonObj  *this, const char *key);
 NOCH_DEF Json **jsonListPush_(JsonList *this, Json *json);
 NOCH_DEF void   jsonListPop  (JsonList *this);
 
-#define jsonDestroy(THIS)      jsonDestroy_  ((Json*)THIS)
-#define jsonPrintF(THIS, FILE) jsonPrintF_   ((Json*)THIS, FILE)
-#define jsonStringify(THIS)    jsonStringify_((Json*)THIS)
+/* Inserting at the size appends, both fail (return NULL or -1) if idx is past the end */
+NOCH_DEF Json **jsonListInsert_(JsonList *this, size_t idx, Json *json);
+NOCH_DEF int    jsonListRemove (JsonList *this, size_t idx);
+
+/* Drop unused capacity, jsonObjShrink also reclaims the holes left by removed keys */
+NOCH_DEF void jsonObjShrink (JsonObj  *this);
+NOCH_DEF void jsonListShrink(JsonList *this);
+
+/* Paths are either JSON pointers (RFC 6901, "/users/0/name") or selectors ("users[0].name",
+   "$.users[-1][\"full name\"]", negative indices count from the end of a list). A compiled path
+   keeps the hashes of its keys, so it can be evaluated against many documents cheaply */
+typedef struct JsonPath JsonPath;
+
+NOCH_DEF JsonPath *jsonPathCompile(const char *path);
+NOCH_DEF void      jsonPathDestroy(JsonPath *this);
+
+#define jsonPathGet(THIS, JSON) jsonPathGet_(THIS, (Json*)JSON)
+#define jsonQuery(JSON, PATH)   jsonQuery_((Json*)JSON, PATH)
+
+/* Both return NULL if the path does not lead to a value */
+NOCH_DEF Json *jsonPathGet_(const JsonPath *this, Json *json);
+NOCH_DEF Json *jsonQuery_  (Json *json, const char *path);
+
+/* JSON patches (RFC 6902) are lists of operations, applied in order. Values of the patch are
+   copied, a document gets copies in its arena. A failing operation leaves the ones before it
+   applied (but does not lose the value it moves), so patch a jsonClone of the tree to apply a
+   patch as a whole or not at all. Unlike jsonEquals, "test" compares numbers by value, so 1 and
+   1.0 are equal */
+#define jsonPatch(ROOT, PATCH)          jsonPatch_         (ROOT, (Json*)PATCH)
+#define jsonDocPatch(THIS, PATCH)       jsonDocPatch_      (THIS, (Json*)PATCH)
+#define jsonMergePatch(ROOT, PATCH)     jsonMergePatch_    (ROOT, (Json*)PATCH)
+#define jsonDocMergePatch(THIS, PATCH)  jsonDocMergePatch_ (THIS, (Json*)PATCH)
+#define jsonPatchText(TEXT, PATCH, LEN) jsonPatchText_     (TEXT, (Json*)PATCH, LEN)
+
+/* Both replace *root if the patch replaces the whole value */
+NOCH_DEF int  jsonPatch_     (Json **root, Json *patch);
+NOCH_DEF void jsonMergePatch_(Json **root, Json *patch); /* RFC 7386, can not fail */
+
+/* Applies a JSON patch to the text of a document without building a tree. The values the
+   pointers lead to are found by skipping over the others, like JsonLazy does, and only their
+   bytes are rewritten: the rest of the text keeps its formatting and comments, and new values are
+   written compactly. Operations are located together in one pass over the text and the new text
+   is built in another; only an operation that depends on an earlier one (like an index into a
+   list that one adds to) starts a new pair of passes. Returns the patched text (heap allocated),
+   or NULL on error */
+NOCH_DEF char *jsonPatchText_(const char *text, Json *patch, size_t *length);
+
+/* Indentation of the output, a positive value indents with that many spaces per level instead */
+enum {
+	JSON_COMPACT    = -1, /* No whitespace or line breaks at all */
+	JSON_INDENT_TAB =  0, /* A tab per level (default) */
+};
+
+#define jsonDestroy(THIS) jsonDestroy_((Json*)THIS)
 
-NOCH_DEF void  jsonDestroy_  (Json *this);
-NOCH_DEF void  jsonPrintF_   (Json *this, FILE *file);
-NOCH_DEF char *jsonStringify_(Json *this);
+/* Deep copies, jsonClone copies into heap nodes (document nodes too) and jsonDocClone into the
+   arena of a document */
+#define jsonClone(THIS)          jsonClone_   ((Json*)THIS)
+#define jsonDocClone(THIS, JSON) jsonDocClone_(THIS, (Json*)JSON)
+
+/* Structural equality and hashing. Object keys are compared regardless of their order, list items
+   in order. Integers and floats are different types, so 1 and 1.0 are not equal. Equal values have
+   the same hash */
+#define jsonEquals(A, B) jsonEquals_((Json*)A, (Json*)B)
+#define jsonHash(THIS)   jsonHash_  ((Json*)THIS)
+
+NOCH_DEF bool     jsonEquals_(Json *a, Json *b);
+NOCH_DEF uint64_t jsonHash_  (Json *this);
+
+#define jsonPrintF(THIS, FILE)           jsonPrintF_      ((Json*)THIS, FILE)
+#define jsonStringify(THIS)              jsonStringify_   ((Json*)THIS)
+#define jsonStringifyTo(THIS, BUF, SIZE) jsonStringifyToEx(THIS, BUF, SIZE, JSON_INDENT_TAB)
+
+#define jsonPrintFEx(THIS, FILE, INDENT)           jsonPrintFEx_     ((Json*)THIS, FILE, INDENT)
+#define jsonStringifyEx(THIS, INDENT)              jsonStringifyEx_  ((Json*)THIS, INDENT)
+#define jsonStringifyToEx(THIS, BUF, SIZE, INDENT) jsonStringifyToEx_((Json*)THIS, BUF, SIZE, INDENT)
+
+NOCH_DEF void  jsonDestroy_    (Json *this);
+NOCH_DEF void  jsonPrintF_     (Json *this, FILE *file); /* Indented with tabs */
+NOCH_DEF char *jsonStringify_  (Json *this);
+NOCH_DEF void  jsonPrintFEx_   (Json *this, FILE *file, int indent);
+NOCH_DEF char *jsonStringifyEx_(Json *this, int indent);
+
+/* Writes into a caller provided buffer like snprintf: the output is cut off to fit (and always NUL
+   terminated if size > 0), the returned length is that of the whole output */
+NOCH_DEF size_t jsonStringifyToEx_(Json *this, char *buf, size_t size, int indent);
+
+#ifdef JSON_POSIX
+#	define jsonPrintFd(THIS, FD)           jsonPrintFdEx(THIS, FD, JSON_INDENT_TAB)
+#	define jsonPrintFdEx(THIS, FD, INDENT) jsonPrintFdEx_((Json*)THIS, FD, INDENT)
+
+/* Returns 0 on success, -1 if writing to the file descriptor failed */
+NOCH_DEF int jsonPrintFdEx_(Json *this, int fd, int indent);
+#endif
 
 NOCH_DEF Json *jsonFromFile  (const char *path);
 NOCH_DEF Json *jsonFromString(const char *str);
 
+/* A document allocates all of its nodes, keys and strings from an arena, which is released as a
+   whole by jsonDocDestroy. jsonDestroy on a document node is a no-op. Nodes added to a document's
+   containers should be created with the jsonDocNew* functions, heap nodes added to them are not
+   freed with the document */
+typedef struct {
+	JsonArena arena;
+	Json     *root;
+} JsonDoc;
+
+NOCH_DEF JsonDoc *jsonDocNew       (void);
+NOCH_DEF JsonDoc *jsonDocFromFile  (const char *path);
+NOCH_DEF JsonDoc *jsonDocFromString(const char *str);
+NOCH_DEF void     jsonDocDestroy   (JsonDoc *this);
+
+NOCH_DEF Json *jsonClone_   (Json *this);
+NOCH_DEF Json *jsonDocClone_(JsonDoc *this, Json *json);
+
+NOCH_DEF int  jsonDocPatch_     (JsonDoc *this, Json *patch);
+NOCH_DEF void jsonDocMergePatch_(JsonDoc *this, Json *patch);
+
+/* Returns the interned copy of a key, or NULL if no object of the document has it. Looking up
+   interned keys with jsonObjAt compares pointers instead of strings */
+NOCH_DEF const char *jsonDocKey(JsonDoc *this, const char *key);
+
+/* Parses without copying strings: string data and object keys point into str, which is unescaped
+   in place and has to stay alive (and unmodified) for as long as the document */
+NOCH_DEF JsonDoc *jsonDocFromStringInSitu(char *str);
+
+NOCH_DEF JsonString *jsonDocNewString(JsonDoc *this, const char *value);
+NOCH_DEF JsonFloat  *jsonDocNewFloat (JsonDoc *this, double      value);
+NOCH_DEF JsonInt    *jsonDocNewInt   (JsonDoc *this, int64_t     value);
+NOCH_DEF JsonBool   *jsonDocNewBool  (JsonDoc *this, bool        value);
+NOCH_DEF JsonList   *jsonDocNewList  (JsonDoc *this);
+NOCH_DEF JsonObj    *jsonDocNewObj   (JsonDoc *this);
+
+/* On-demand access to the text of a document, without building a tree. Looking up a key or an
+   index skips the values before it by matching brackets, and only the values that are read get
+   decoded. Parts of the text that are skipped are not validated. A JsonLazy points into the text,
+   which has to stay alive for as long as it is used. Functions returning int return 0 on success
+   and -1 on error (including missing keys and indices) */
+typedef struct {
+	const char *in, *it; /* Input and the start of the value */
+} JsonLazy;
+
+NOCH_DEF int   jsonLazyFromString(const char *str, JsonLazy *root);
+NOCH_DEF int   jsonLazyObjAt     (const JsonLazy *this, const char *key, JsonLazy *value);
+NOCH_DEF int   jsonLazyListAt    (const JsonLazy *this, size_t      idx, JsonLazy *value);
+NOCH_DEF int   jsonLazyType      (const JsonLazy *this); /* Returns -1 if the value is invalid */
+NOCH_DEF char *jsonLazyString    (const JsonLazy *this, size_t *length); /* Heap allocated */
+NOCH_DEF int   jsonLazyInt       (const JsonLazy *this, int64_t *value);
+NOCH_DEF int   jsonLazyFloat     (const JsonLazy *this, double  *value); /* Integers too */
+NOCH_DEF int   jsonLazyBool      (const JsonLazy *this, bool    *value);
+NOCH_DEF Json *jsonLazyParse     (const JsonLazy *this); /* Builds a heap tree of the value */
+
+/* CBOR (RFC 8949) encoding of the tree. Byte strings decode to strings, tags are ignored and
+   integers outside of the int64_t range decode to floats. The in situ decoder does not copy strings,
+   it moves each one over its (at least a byte long) head to NUL terminate it, so buf has to be
+   writable and stay alive for as long as the document */
+#define jsonToCbor(THIS, SIZE)  jsonToCbor_ ((Json*)THIS, SIZE)
+#define jsonToCborF(THIS, FILE) jsonToCborF_((Json*)THIS, FILE)
+
+NOCH_DEF char *jsonToCbor_ (Json *this, size_t *size); /* Heap allocated */
+NOCH_DEF int   jsonToCborF_(Json *this, FILE *file);
+
+NOCH_DEF Json    *jsonFromCbor         (const void *buf, size_t size);
+NOCH_DEF JsonDoc *jsonDocFromCbor      (const void *buf, size_t size);
+NOCH_DEF JsonDoc *jsonDocFromCborInSitu(void       *buf, size_t size);
+
+/* Decoding straight into C structs, described by tables of fields that end with JSON_FIELDS_END.
+   Member types are bool, int64_t, double, char* (heap allocated, NULL for null), a nested struct
+   with its own table, or a list as a pointer to the items with a size_t count member next to it.
+   Unknown keys are skipped, missing keys and nulls leave the members as they were, so the struct
+   has to be initialized (zeroed) before decoding. On error the struct can hold partially decoded
+   values, jsonStructFree releases those too */
+enum {
+	JSON_FIELD_BOOL = 1,
+	JSON_FIELD_INT,
+	JSON_FIELD_FLOAT,
+	JSON_FIELD_STRING,
+	JSON_FIELD_STRUCT,
+	JSON_FIELD_LIST,
+};
+
+typedef struct JsonField {
+	const char *name;
+	int         type;
+	size_t      offset;
+
+	const struct JsonField *fields;      /* Table of a struct, or the item of a list */
+	size_t                  size;        /* Size of a list item */
+	size_t                  countOffset; /* Offset of the count of a list */
+} JsonField;
+
+#define JSON_FIELDS_END {NULL, 0, 0, NULL, 0, 0}
+
+#define JSON_MEMBER(STRUCT, MEMBER, TYPE) \
+	{#MEMBER, JSON_FIELD_##TYPE, offsetof(STRUCT, MEMBER), NULL, 0, 0}
+#define JSON_MEMBER_STRUCT(STRUCT, MEMBER, FIELDS) \
+	{#MEMBER, JSON_FIELD_STRUCT, offsetof(STRUCT, MEMBER), FIELDS, 0, 0}
+#define JSON_MEMBER_LIST(STRUCT, MEMBER, COUNT, ITEM) \
+	{#MEMBER, JSON_FIELD_LIST, offsetof(STRUCT, MEMBER), ITEM, 0, offsetof(STRUCT, COUNT)}
+
+/* Items of lists, ITEM in JSON_MEMBER_LIST points to one of these */
+#define JSON_ITEM(T, TYPE)           {NULL, JSON_FIELD_##TYPE, 0, NULL,   sizeof(T), 0}
+#define JSON_ITEM_STRUCT(T, FIELDS)  {NULL, JSON_FIELD_STRUCT, 0, FIELDS, sizeof(T), 0}
+
+/* Return 0 on success, -1 on error */
+NOCH_DEF int jsonStructFromFile  (const char *path, const JsonField *fields, void *out);
+NOCH_DEF int jsonStructFromString(const char *str,  const JsonField *fields, void *out);
+
+NOCH_DEF char *jsonStructStringify(const JsonField *fields, const void *in, int indent);
+NOCH_DEF void  jsonStructFree     (const JsonField *fields, void *this);
+
+/* Callbacks of the event parser, any of them can be NULL. Keys and strings passed to the callbacks
+   are only valid for the duration of the call. Returning non-zero from a callback stops the parser,
+   which then returns that value */
+typedef struct {
+	int (*objBegin) (void *data);
+	int (*objEnd)   (void *data);
+	int (*listBegin)(void *data);
+	int (*listEnd)  (void *data);
+	int (*key)      (void *data, const char *key,   size_t length);
+	int (*string)   (void *data, const char *value, size_t length);
+	int (*floatx)   (void *data, double  value);
+	int (*intx)     (void *data, int64_t value);
+	int (*boolx)    (void *data, bool    value);
+	int (*null)     (void *data);
+} JsonHandler;
+
+NOCH_DEF int jsonEventsFromFile  (const char *path, const JsonHandler *handler, void *data);
+NOCH_DEF int jsonEventsFromString(const char *str,  const JsonHandler *handler, void *data);
+
+#ifndef JSON_READ_CHUNK_SIZE
+#	define JSON_READ_CHUNK_SIZE (64 * 1024)
+#endif
+
+/* Incremental event parser for input that arrives in chunks (pipes, sockets). Chunks can be split
+   at any byte, the parser keeps its state between them and only buffers the unfinished token.
+   Feed and finish return 0 on success, once they fail or a callback stops the parser every further
+   call returns the same value */
+typedef struct JsonPushParser JsonPushParser;
+
+NOCH_DEF JsonPushParser *jsonPushParserNew    (const JsonHandler *handler, void *data);
+NOCH_DEF void            jsonPushParserDestroy(JsonPushParser *this);
+NOCH_DEF int             jsonPushParserFeed   (JsonPushParser *this, const char *buf, size_t size);
+NOCH_DEF int             jsonPushParserFinish (JsonPushParser *this);
+
+/* JSON Lines (newline delimited JSON) reader. Records are parsed on a pool of worker threads
+   (threads = 0 uses one per CPU) and handed to the callback on the calling thread, either in input
+   order or as soon as they are parsed. The callback takes ownership of the record, line is its 1 based
+   line number. Blank lines are skipped. Returning non-zero from the callback stops the reader, which
+   then returns that value */
+typedef int (*JsonLinesCallback)(void *data, size_t line, Json *json);
+
+#ifndef JSON_LINES_BATCH_SIZE
+#	define JSON_LINES_BATCH_SIZE 4096 /* Records in flight at once */
+#endif
+
+NOCH_DEF int jsonLinesFromFile  (const char *path, size_t threads, bool ordered,
+                                 JsonLinesCallback callback, void *data);
+NOCH_DEF int jsonLinesFromString(const char *str,  size_t threads, bool ordered,
+                                 JsonLinesCallback callback, void *data);
+
 #ifdef __cplusplus
 }
 #endif
@@ -83,10 +83,21 @@ NOCH_DEF double meError(size_t pos, const char *fmt, ...) {
 	vsnprintf(str, sizeof(str), fmt, args);
 	va_end(args);
 
-	nochError("%lu: %s", (long unsigned)pos, str);
+	nochErrorAt(NOCH_ERROR_INVALID, NULL, 0, pos, "%s", str);
 	return NAN;
 }
 
+/* Errors of the parser, as opposed to those of evaluation */
+static void meSyntaxError(size_t pos, const char *fmt, ...) {
+	char    str[256];
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(str, sizeof(str), fmt, args);
+	va_end(args);
+
+	nochErrorAt(NOCH_ERROR_SYNTAX, NULL, 0, pos, "%s", str);
+}
+
 static double meDiv(size_t pos, double a, double b) {
 	if (b == 0)
 		return meError(pos, "Division by zero");
@@ -431,7 +442,7 @@ inline static bool meCharIsOneOf(MeParser *this, const char *chs) {
 static int meSkipWhitespaces(MeParser *this) {
 	while (isspace(ME_CHAR(this))) {
 		if (*this->it == '\n') {
-			meError(ME_POS(this), "Unexpected end of line\n");
+			meSyntaxError(ME_POS(this), "Unexpected end of line\n");
 			return -1;
 		}
 
@@ -447,7 +458,7 @@ static void meTokenDataClear(MeParser *this) {
 
 static int meTokenDataAddChar(MeParser *this, char ch) {
 	if (this->dataSize + 1 >= ME_TOKEN_CAPACITY) {
-		meError(ME_POS(this), "Token exceeded maximum length of %i", ME_TOKEN_CAPACITY - 1);
+		meSyntaxError(ME_POS(this), "Token exceeded maximum length of %i", ME_TOKEN_CAPACITY - 1);
 		return -1;
 	}
 
@@ -484,7 +495,8 @@ static MeExpr *meParseId(MeParser *this) {
 
 	while (true) {
 		if (func->argsCount >= ME_MAX_ARGS) {
-			meError(ME_POS(this), "Exceeded maximum amount of %i function arguments", ME_MAX_ARGS);
+			meSyntaxError(ME_POS(this), "Exceeded maximum amount of %i function arguments",
+			              ME_MAX_ARGS);
 			goto fail;
 		}
 
@@ -497,7 +509,7 @@ static MeExpr *meParseId(MeParser *this) {
 		if (ME_CHAR(this) == ')')
 			break;
 		else if (ME_CHAR(this) != ',') {
-			meError(ME_POS(this), "Expected a \",\" or a matching \")\"");
+			meSyntaxError(ME_POS(this), "Expected a \",\" or a matching \")\"");
 			goto fail;
 		}
 
@@ -524,7 +536,7 @@ static MeExpr *meParseNumber(MeParser *this) {
 			continue;
 		} else if (*this->it == 'e') {
 			if (exponent) {
-				meError(ME_POS(this), "Encountered exponent in number twice");
+				meSyntaxError(ME_POS(this), "Encountered exponent in number twice");
 				return NULL;
 			}
 
@@ -535,21 +547,21 @@ static MeExpr *meParseNumber(MeParser *this) {
 			}
 
 			if (!isdigit(ME_PEEK(this, 1))) {
-				meError(ME_POS(this), "expected a digit after exponent");
+				meSyntaxError(ME_POS(this), "expected a digit after exponent");
 				return NULL;
 			}
 		} else if (*this->it == '.') {
 			if (floatingPoint) {
-				meError(ME_POS(this), "Encountered floating point in number twice");
+				meSyntaxError(ME_POS(this), "Encountered floating point in number twice");
 				return NULL;
 			} else if (exponent) {
-				meError(ME_POS(this), "Unexpected floating point in exponent");
+				meSyntaxError(ME_POS(this), "Unexpected floating point in exponent");
 				return NULL;
 			}
 
 			floatingPoint = true;
 			if (!isdigit(ME_PEEK(this, 1))) {
-				meError(ME_POS(this), "expected a digit after floating point");
+				meSyntaxError(ME_POS(this), "expected a digit after floating point");
 				return NULL;
 			}
 		} else if (!isdigit(*this->it))
@@ -589,7 +601,7 @@ static MeExpr *meParseParens(MeParser *this) {
 
 	if (ME_CHAR(this) != closing) {
 		meDestroy(expr);
-		meError(pos, "Expected a matching \"%c\"", closing);
+		meSyntaxError(pos, "Expected a matching \"%c\"", closing);
 		return NULL;
 	}
 
@@ -609,7 +621,7 @@ static MeExpr *meParsePipes(MeParser *this) {
 
 	if (ME_CHAR(this) != '|') {
 		meDestroy(expr);
-		meError(pos, "Expected a matching \"|\"");
+		meSyntaxError(pos, "Expected a matching \"|\"");
 		return NULL;
 	}
 
@@ -624,7 +636,7 @@ static MeExpr *meParseFactor(MeParser *this) {
 	MeExpr *parsed;
 	switch (ME_CHAR(this)) {
 	case '\0':
-		meError(ME_POS(this), "Unexpected end of input");
+		meSyntaxError(ME_POS(this), "Unexpected end of input");
 		return NULL;
 
 	case '|':
@@ -640,7 +652,7 @@ static MeExpr *meParseFactor(MeParser *this) {
 		else if (isdigit(*this->it))
 			parsed = meParseNumber(this);
 		else {
-			meError(ME_POS(this), "Unexpected character \"%c\"", *this->it);
+			meSyntaxError(ME_POS(this), "Unexpected character \"%c\"", *this->it);
 			return NULL;
 		}
 	}
@@ -746,7 +758,7 @@ NOCH_DEF MeExpr *meParse(const char *start, const char *end) {
 	MeExpr *expr = meParseExpr(&parser);
 
 	if (!ME_END(&parser)) {
-		meError(ME_POS(&parser), "Expected end of input");
+		meSyntaxError(ME_POS(&parser), "Expected end of input");
 		meDestroy(expr);
 		return NULL;
 	}